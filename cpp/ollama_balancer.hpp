@@ -0,0 +1,211 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <set>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <nlohmann/json.hpp>
+#include "ollama_http.hpp"
+
+const long HEALTH_CHECK_TIMEOUT = 2;      // Segundos para /api/tags y /api/ps
+const long long NODE_RETRY_MS = 5000;     // Un nodo caído vuelve a probarse tras este tiempo
+const long long AFFINITY_REFRESH_MS = 10000; // Frecuencia de refresco de /api/ps
+
+inline long long balancerNowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Un servidor Ollama con su carga actual y modelos cargados
+struct Endpoint {
+    std::string url;
+    std::atomic<int> outstanding{0};
+    std::atomic<bool> healthy{true};
+    std::atomic<long long> downSince{0};
+    std::atomic<unsigned long long> served{0};
+    std::atomic<unsigned long long> failures{0};
+    std::mutex modelsMutex;
+    std::set<std::string> loadedModels;
+
+    explicit Endpoint(const std::string& u) : url(u) {}
+
+    bool hasModel(const std::string& model) {
+        std::lock_guard<std::mutex> lock(modelsMutex);
+        return loadedModels.count(model) > 0;
+    }
+};
+
+// Errores de transporte que justifican probar otro nodo
+inline bool isFailoverError(CURLcode res) {
+    return res == CURLE_COULDNT_CONNECT || res == CURLE_COULDNT_RESOLVE_HOST ||
+           res == CURLE_OPERATION_TIMEDOUT || res == CURLE_GOT_NOTHING ||
+           res == CURLE_SEND_ERROR || res == CURLE_RECV_ERROR;
+}
+
+// Lista de endpoints con enrutado por menor número de peticiones en curso,
+// failover ante errores de conexión/timeout y afinidad opcional por modelo.
+class EndpointPool {
+private:
+    std::vector<std::unique_ptr<Endpoint>> nodes;
+    std::atomic<unsigned> roundRobin{0};
+    std::atomic<long long> lastAffinityRefresh{0};
+    std::mutex refreshMutex;
+    bool affinity = false;
+
+    // Un nodo caído es elegible otra vez pasado NODE_RETRY_MS (semiabierto)
+    static bool available(const Endpoint& e, long long now) {
+        return e.healthy || now - e.downSince >= NODE_RETRY_MS;
+    }
+
+public:
+    // 'list' separada por comas: "http://a:11434,http://b:11434"
+    explicit EndpointPool(const std::string& list) {
+        size_t start = 0;
+        while (start <= list.size()) {
+            size_t comma = list.find(',', start);
+            std::string url = list.substr(start, comma == std::string::npos ? std::string::npos : comma - start);
+            while (!url.empty() && (url.back() == '/' || url.back() == ' ')) {
+                url.pop_back();
+            }
+            size_t first = url.find_first_not_of(' ');
+            if (first != std::string::npos) {
+                nodes.emplace_back(new Endpoint(url.substr(first)));
+            }
+            if (comma == std::string::npos) {
+                break;
+            }
+            start = comma + 1;
+        }
+    }
+
+    EndpointPool(const EndpointPool&) = delete;
+    EndpointPool& operator=(const EndpointPool&) = delete;
+
+    void setAffinity(bool enabled) { affinity = enabled; }
+    bool affinityEnabled() const { return affinity; }
+    size_t size() const { return nodes.size(); }
+    Endpoint& node(size_t i) { return *nodes[i]; }
+
+    // Elegir nodo: disponibles, no excluidos, con el modelo cargado si hay afinidad; menor carga
+    Endpoint* pick(const std::string& model, const std::vector<Endpoint*>& exclude) {
+        long long now = balancerNowMs();
+        Endpoint* best = nullptr;
+        bool bestHasModel = false;
+        size_t n = nodes.size();
+        Endpoint* oldestDown = nullptr;
+        size_t offset = n > 0 ? roundRobin++ % n : 0; // Reparte los empates
+        for (size_t k = 0; k < n; ++k) {
+            Endpoint* e = nodes[(offset + k) % n].get();
+            bool excluded = false;
+            for (Endpoint* x : exclude) {
+                excluded = excluded || x == e;
+            }
+            if (excluded) {
+                continue;
+            }
+            if (!available(*e, now)) {
+                if (!oldestDown || e->downSince < oldestDown->downSince) {
+                    oldestDown = e;
+                }
+                continue;
+            }
+            bool hasModel = affinity && !model.empty() && e->hasModel(model);
+            if (!best || (hasModel && !bestHasModel) ||
+                (hasModel == bestHasModel && e->outstanding < best->outstanding)) {
+                best = e;
+                bestHasModel = hasModel;
+            }
+        }
+        // Todos caídos: probar igualmente el que lleva más tiempo sin responder
+        return best ? best : oldestDown;
+    }
+
+    void markDown(Endpoint* e) {
+        e->failures++;
+        e->downSince = balancerNowMs();
+        e->healthy = false;
+    }
+
+    // Respuesta correcta: el nodo está sano y (afinidad aprendida) tiene el modelo cargado
+    void markServed(Endpoint* e, const std::string& model) {
+        e->served++;
+        e->healthy = true;
+        if (!model.empty()) {
+            std::lock_guard<std::mutex> lock(e->modelsMutex);
+            e->loadedModels.insert(model);
+        }
+    }
+
+    // Sondear todos los nodos (/api/tags) y refrescar modelos cargados (/api/ps)
+    void healthCheck(CurlPool& pool) {
+        for (auto& e : nodes) {
+            std::string body;
+            if (httpRequest(pool, e->url + "/api/tags", "", HEALTH_CHECK_TIMEOUT, body) != CURLE_OK) {
+                markDown(e.get());
+                continue;
+            }
+            e->healthy = true;
+            refreshModels(pool, *e);
+        }
+        lastAffinityRefresh = balancerNowMs();
+    }
+
+    // Refresco de /api/ps si caducó; solo un hilo lo hace y el resto sigue con los datos previos.
+    // El primero sí se espera: sin él las primeras peticiones irían a cualquier nodo.
+    void refreshAffinityIfStale(CurlPool& pool) {
+        if (!affinity || balancerNowMs() - lastAffinityRefresh < AFFINITY_REFRESH_MS) {
+            return;
+        }
+        std::unique_lock<std::mutex> lock(refreshMutex, std::defer_lock);
+        if (lastAffinityRefresh == 0) {
+            lock.lock();
+            if (lastAffinityRefresh != 0) {
+                return;
+            }
+        } else if (!lock.try_lock()) {
+            return;
+        }
+        long long now = balancerNowMs();
+        for (auto& e : nodes) {
+            if (available(*e, now)) {
+                refreshModels(pool, *e);
+            }
+        }
+        lastAffinityRefresh = balancerNowMs();
+    }
+
+private:
+    void refreshModels(CurlPool& pool, Endpoint& e) {
+        std::string body;
+        if (httpRequest(pool, e.url + "/api/ps", "", HEALTH_CHECK_TIMEOUT, body) != CURLE_OK) {
+            return;
+        }
+        nlohmann::json ps = nlohmann::json::parse(body, nullptr, false);
+        if (ps.is_discarded() || !ps.contains("models") || !ps["models"].is_array()) {
+            return;
+        }
+        std::set<std::string> models;
+        for (const auto& m : ps["models"]) {
+            if (m.contains("name") && m["name"].is_string()) {
+                models.insert(m["name"].get<std::string>());
+            }
+        }
+        std::lock_guard<std::mutex> lock(e.modelsMutex);
+        e.loadedModels.swap(models);
+    }
+};
+
+// Reserva de un nodo mientras dura la petición (cuenta como 'outstanding')
+class EndpointLease {
+private:
+    Endpoint* e;
+
+public:
+    explicit EndpointLease(Endpoint* endpoint) : e(endpoint) { e->outstanding++; }
+    ~EndpointLease() { e->outstanding--; }
+    EndpointLease(const EndpointLease&) = delete;
+    EndpointLease& operator=(const EndpointLease&) = delete;
+};
@@ -0,0 +1,337 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <iomanip>
+#include <algorithm>
+#include <functional>
+#include <filesystem>
+#include <cstdlib>
+#include <cstdio>
+#include <new>
+#include "ollama_client.hpp"
+#include "ollama_daemon.hpp"
+#include "ollama_mock.hpp"
+
+// Benchmark de OllamaClient: micro (cache, hash, JSON) y macro (ida y vuelta HTTP)
+
+const size_t DEFAULT_ITERATIONS = 20000;   // Iteraciones de las pruebas micro
+const size_t ROUNDTRIP_ITERATIONS = 2000;  // Peticiones contra el mock
+const size_t REAL_ITERATIONS = 5;          // Peticiones contra un servidor real (lentas)
+const size_t BENCH_CACHE_SIZE = 1 << 16;   // Entradas máximas del cache de prueba
+
+// GCC no sabe que estos operadores sustituyen a los globales y avisa de malloc/free
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+// Contador de reservas por hilo (operator new); libcurl usa malloc y no se cuenta
+thread_local size_t threadAllocations = 0;
+
+void* operator new(std::size_t size) {
+    threadAllocations++;
+    void* p = std::malloc(size ? size : 1);
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+// Resultado de una prueba: latencias por iteración en nanosegundos
+struct BenchResult {
+    std::string name;
+    std::vector<long long> samples;
+    size_t allocations = 0;
+};
+
+// Ejecutar 'op' n veces midiendo cada iteración por separado
+BenchResult runBench(const std::string& name, size_t n, const std::function<void(size_t)>& op) {
+    BenchResult r;
+    r.name = name;
+    r.samples.reserve(n);
+    size_t allocsBefore = threadAllocations;
+    for (size_t i = 0; i < n; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        op(i);
+        auto end = std::chrono::steady_clock::now();
+        r.samples.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+    }
+    // Las reservas de 'samples' ya se hicieron antes de medir
+    r.allocations = threadAllocations - allocsBefore;
+    return r;
+}
+
+// Formatear nanosegundos con la unidad adecuada
+std::string formatNs(double ns) {
+    char buf[32];
+    if (ns < 1e3) {
+        std::snprintf(buf, sizeof(buf), "%.0fns", ns);
+    } else if (ns < 1e6) {
+        std::snprintf(buf, sizeof(buf), "%.1fµs", ns / 1e3);
+    } else {
+        std::snprintf(buf, sizeof(buf), "%.2fms", ns / 1e6);
+    }
+    return buf;
+}
+
+void report(BenchResult r) {
+    if (r.samples.empty()) {
+        return;
+    }
+    std::vector<long long>& s = r.samples;
+    std::sort(s.begin(), s.end());
+    auto pct = [&s](double p) {
+        size_t idx = static_cast<size_t>(p * (s.size() - 1));
+        return static_cast<double>(s[idx]);
+    };
+    double total = 0;
+    for (long long v : s) {
+        total += v;
+    }
+    double opsPerSec = total > 0 ? s.size() * 1e9 / total : 0;
+    double allocsPerOp = static_cast<double>(r.allocations) / s.size();
+
+    std::cout << "  " << std::left << std::setw(20) << r.name << std::right
+              << std::setw(8) << s.size() << " ops"
+              << "  p50 " << std::setw(9) << formatNs(pct(0.50))
+              << "  p95 " << std::setw(9) << formatNs(pct(0.95))
+              << "  p99 " << std::setw(9) << formatNs(pct(0.99))
+              << "  " << std::setw(10) << std::fixed << std::setprecision(0) << opsPerSec << " ops/s"
+              << "  " << std::setw(6) << std::setprecision(1) << allocsPerOp << " allocs/op"
+              << std::endl;
+}
+
+// Respuesta típica de /api/generate (con 'context', que domina el tamaño)
+std::string sampleResponse() {
+    std::string body = "{\"model\":\"codellama:7b-code-q4_K_M\",\"created_at\":\"2025-01-01T00:00:00Z\","
+                       "\"response\":\"Una función en C++ se declara con el tipo de retorno, el nombre y "
+                       "los parámetros entre paréntesis.\",\"done\":true,\"context\":[";
+    for (int i = 0; i < 512; ++i) {
+        if (i > 0) {
+            body += ',';
+        }
+        body += std::to_string(1000 + i * 7);
+    }
+    body += "],\"total_duration\":1523000000,\"load_duration\":2000000,\"prompt_eval_count\":26,"
+            "\"prompt_eval_duration\":130000000,\"eval_count\":100,\"eval_duration\":1390000000}";
+    return body;
+}
+
+int main(int argc, char* argv[]) {
+    size_t iterations = DEFAULT_ITERATIONS;
+    size_t roundtrips = ROUNDTRIP_ITERATIONS;
+    size_t realIterations = REAL_ITERATIONS;
+    bool runReal = true;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--iterations" && i + 1 < argc) {
+            iterations = std::strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "--roundtrips" && i + 1 < argc) {
+            roundtrips = std::strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "--real" && i + 1 < argc) {
+            realIterations = std::strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "--no-real") {
+            runReal = false;
+        } else {
+            std::cout << "Uso: " << argv[0]
+                      << " [--iterations N] [--roundtrips N] [--real N] [--no-real]" << std::endl;
+            return 1;
+        }
+    }
+    if (iterations == 0 || roundtrips == 0) {
+        std::cerr << "❌ Error: las iteraciones deben ser > 0" << std::endl;
+        return 1;
+    }
+
+    const std::string prompt = "¿Cómo se declara una función en C++? Explica con un ejemplo corto.";
+    std::cout << "🏁 Ollama C++ Benchmark" << std::endl;
+
+    // Cache: archivo propio para no tocar el de los clientes
+    std::cout << std::endl << "📦 Cache" << std::endl;
+    {
+        std::string path = (std::filesystem::temp_directory_path() / "ollama_bench_cache.bin").string();
+        std::remove(path.c_str());
+        {
+            PersistentCache cache(path, BENCH_CACHE_SIZE);
+            size_t n = std::min(iterations, BENCH_CACHE_SIZE);
+            std::vector<CacheKey> keys;
+            keys.reserve(n);
+            for (size_t i = 0; i < n; ++i) {
+                keys.push_back(generateHash(prompt + std::to_string(i), DEFAULT_MODEL, ASK_OPTIONS));
+            }
+            const std::string value = sampleResponse();
+            std::string out;
+            out.reserve(value.size());
+
+            report(runBench("cache put", n, [&](size_t i) {
+                cache.put(keys[i], value, CACHE_EXPIRY);
+            }));
+            report(runBench("cache get (hit)", n, [&](size_t i) {
+                cache.get(keys[i], out);
+            }));
+            CacheKey missing = generateHash("no existe", DEFAULT_MODEL, ASK_OPTIONS);
+            report(runBench("cache get (miss)", n, [&](size_t) {
+                cache.get(missing, out);
+            }));
+
+            // Respuesta larga: pasa el umbral de compresión (CODEC_MIN_SIZE)
+            std::string longValue;
+            while (longValue.size() < 4096) {
+                longValue += value;
+            }
+            cache.clear();
+            report(runBench(std::string("cache put 4KB (") + codecName(CODEC_DEFAULT) + ")", n, [&](size_t i) {
+                cache.put(keys[i], longValue, CACHE_EXPIRY);
+            }));
+            report(runBench(std::string("cache get 4KB (") + codecName(CODEC_DEFAULT) + ")", n, [&](size_t i) {
+                cache.get(keys[i], out);
+            }));
+            // Contadores de las cabeceras: no depende del número de entradas
+            report(runBench("cache stats", std::min<size_t>(n, 1000), [&](size_t) {
+                cache.stats();
+            }));
+            CacheStats st = cache.stats();
+            std::cout << "   " << st.compressed << " comprimidas: " << st.bytes / 1024 << " KB de "
+                      << st.rawBytes / 1024 << " KB" << std::endl;
+        }
+        std::remove(path.c_str());
+    }
+
+    // Pasos del cliente sin red
+    std::cout << std::endl << "🔑 Cliente (sin red)" << std::endl;
+    {
+        OllamaClient client;
+        report(runBench("key hash", iterations, [&](size_t) {
+            generateHash(prompt, DEFAULT_MODEL, ASK_OPTIONS);
+        }));
+        report(runBench("request build", iterations, [&](size_t) {
+            client.buildBody(prompt, ASK_OPTIONS);
+        }));
+        report(runBench("request DOM (ref)", iterations, [&](size_t) {
+            std::string body = client.requestBody(prompt, ASK_OPTIONS, false).dump();
+        }));
+        const std::string body = sampleResponse();
+        // Archivo fuente pegado como prompt: comillas, barras, saltos y tabuladores cada pocos bytes
+        std::string source;
+        while (source.size() < 100 * 1024) {
+            source += "\tstd::cout << \"línea \" << i << \"\\n\"; // comentario con texto normal\n"
+                      "    int total = calcular(valores, tamaño) * factor + ajuste;\n";
+        }
+        std::string escaped;
+        report(runBench(std::string("escape 100KB (") + jsonEscapeIsa() + ")", iterations / 100, [&](size_t) {
+            escaped.clear();
+            appendJsonEscaped(escaped, source);
+        }));
+        report(runBench("escape 100KB (scalar)", iterations / 100, [&](size_t) {
+            escaped.clear();
+            appendJsonEscaped(escaped, source.data(), source.size(), jsonEscapeScanScalar);
+        }));
+        report(runBench("response parse", iterations, [&](size_t) {
+            scanGenerateReply(body);
+        }));
+        report(runBench("response DOM (ref)", iterations, [&](size_t) {
+            json parsed = json::parse(body);
+        }));
+        report(runBench("metrics record", iterations, [&](size_t i) {
+            recordUs(Phase::Parse, static_cast<long long>(i));
+        }));
+        RequestScheduler scheduler(DEFAULT_NUM_PARALLEL);
+        report(runBench("scheduler ticket", iterations, [&](size_t) {
+            SchedulerTicket ticket(scheduler, DEFAULT_MODEL, scheduler.estimate(DEFAULT_MODEL, 20, prompt.size()),
+                                   Priority::Interactive);
+        }));
+        LatencyTracker latency;
+        const std::string latencyClass = latencyKey(DEFAULT_MODEL, "100");
+        report(runBench("adaptive timeout", iterations, [&](size_t i) {
+            latency.record(latencyClass, static_cast<long long>(800 + i % 200));
+            latency.timeoutFor(latencyClass, DEFAULT_TIMEOUT);
+        }));
+        report(runBench("prompt normalize", iterations, [&](size_t) {
+            normalizePrompt(prompt);
+        }));
+        // Índice semántico lleno con vectores de 768 dimensiones (nomic-embed-text)
+        const size_t dim = 768;
+        SemanticIndex index;
+        std::vector<float> v(dim);
+        for (size_t i = 0; i < SEMANTIC_INDEX_MAX / 4; ++i) {
+            for (size_t d = 0; d < dim; ++d) {
+                v[d] = static_cast<float>((i * 31 + d * 17) % 97) - 48.0f;
+            }
+            index.add(1, v.data(), dim, generateHash(std::to_string(i), DEFAULT_MODEL, ASK_OPTIONS));
+        }
+        CacheKey similarKey;
+        float score = 0;
+        report(runBench("semantic nearest (" + std::to_string(index.size()) + "x768)", iterations / 100, [&](size_t) {
+            index.nearest(1, v.data(), dim, 0.99f, similarKey, score);
+        }));
+    }
+
+    // Ida y vuelta completa contra el mock en proceso (sin cache)
+    std::cout << std::endl << "🧪 Ida y vuelta (mock)" << std::endl;
+    {
+        MockServer mock;
+        if (!mock.start()) {
+            std::cerr << "❌ Error: no se pudo iniciar el servidor mock" << std::endl;
+            return 1;
+        }
+        OllamaClient client(DEFAULT_MODEL, mock.url());
+        client.query(prompt, ASK_OPTIONS, false); // Abrir la conexión antes de medir
+        report(runBench("query (mock)", roundtrips, [&](size_t) {
+            client.query(prompt, ASK_OPTIONS, false);
+        }));
+        report(runBench("stream (mock)", roundtrips, [&](size_t) {
+            client.askStream(prompt, [](const std::string&) {});
+        }));
+        mock.stop();
+    }
+
+    // Ida y vuelta por el canal del daemon (serve) en proceso: trama, hilo del servidor y respuesta
+    std::cout << std::endl << "🛰️  Daemon (IPC)" << std::endl;
+    {
+        OllamaClient client;
+        DaemonServer daemon(client);
+        std::string path = defaultIpcPath() + ".bench";
+        if (!daemon.start(path)) {
+            std::cout << "  ⚠️  No se pudo escuchar en " << path << ", se omite" << std::endl;
+        } else {
+            DaemonClient ipc;
+            ipc.connect(path);
+            CacheStats st;
+            report(runBench("daemon cachestats", roundtrips, [&](size_t) {
+                ipc.cacheStats(st);
+            }));
+            std::string dump;
+            report(runBench("daemon metrics", roundtrips, [&](size_t) {
+                ipc.metricsDump(false, dump);
+            }));
+            daemon.stop();
+        }
+    }
+
+    // Ida y vuelta contra un servidor real, si responde
+    if (runReal && realIterations > 0) {
+        std::string endpoint = defaultEndpoint();
+        std::cout << std::endl << "🤖 Ida y vuelta (" << endpoint << ")" << std::endl;
+
+        CurlPool probePool;
+        EndpointPool nodes(endpoint);
+        nodes.healthCheck(probePool);
+        bool reachable = false;
+        for (size_t i = 0; i < nodes.size(); ++i) {
+            reachable = reachable || nodes.node(i).healthy;
+        }
+        if (!reachable) {
+            std::cout << "  ⚠️  Servidor no disponible, se omite" << std::endl;
+        } else {
+            OllamaClient client(DEFAULT_MODEL, endpoint);
+            report(runBench("query (real)", realIterations, [&](size_t) {
+                client.query(prompt, ASK_OPTIONS, false);
+            }));
+        }
+    }
+
+    return 0;
+}
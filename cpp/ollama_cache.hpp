@@ -0,0 +1,692 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <shared_mutex>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+#include "ollama_mmap.hpp"
+#include "ollama_hash.hpp"
+#include "ollama_codec.hpp"
+
+// Formato del archivo de cache persistente (todo little-endian, compartido con python/ollama_cache.py):
+//   [cabecera 64 bytes][cabeceras de shard 64 bytes c/u][slots por shard][región de datos append-only]
+// Cada shard es una tabla de direccionamiento abierto con su propio lock y reloj (CLOCK) de expulsión.
+// Varios procesos pueden abrir el mismo archivo: los locks son además rangos de 1 byte del archivo
+// (fcntl / LockFileEx), que no protegen datos sino que sirven de nombre:
+//   byte 0 = mapa (compartido para leer/insertar, exclusivo para crecer, compactar o vaciar),
+//   byte 1 = región de datos, byte 2 + n = shard n.
+const char CACHE_FILE_MAGIC[8] = {'O', 'L', 'L', 'C', 'A', 'C', 'H', 'E'};
+const uint32_t CACHE_FILE_VERSION = 6; // v6: locks entre procesos y contadores de estadísticas en las cabeceras
+const uint64_t CACHE_DATA_INITIAL = 1 << 20; // 1 MB inicial para datos
+const uint32_t CACHE_SHARDS = 16;
+const uint64_t CACHE_DEFAULT_MAX_BYTES = 64ULL << 20; // Presupuesto de datos vivos (OLLAMA_CACHE_MAX_BYTES)
+const uint32_t CACHE_SWEEP_PER_INSERT = 8;  // Slots revisados en cada put: el shard entero cada slots/8 inserciones
+const uint32_t CACHE_SWEEP_CHUNK = 256;     // Slots por toma del lock en cleanup()
+
+const uint64_t CACHE_LOCK_MAP = 0;
+const uint64_t CACHE_LOCK_DATA = 1;
+const uint64_t CACHE_LOCK_SHARD = 2; // + número de shard
+
+const uint16_t SLOT_EMPTY = 0;
+const uint16_t SLOT_USED = 1;
+const uint16_t SLOT_DELETED = 2;
+
+struct CacheFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t shardCount;
+    uint32_t slotsPerShard;
+    uint32_t reserved0;
+    uint64_t dataOffset;
+    uint64_t dataEnd;
+    uint64_t fileBytes;   // Tamaño del archivo tras el último cambio: si no cuadra con el mapa, otro proceso lo cambió
+    uint64_t reserved[2];
+};
+static_assert(sizeof(CacheFileHeader) == 64, "cabecera de cache debe ocupar 64 bytes");
+
+struct CacheShardHeader {
+    uint32_t entryCount;
+    uint32_t tombstoneCount;
+    uint32_t clockHand;
+    uint32_t sweepHand;   // Próximo slot que revisa el barrido incremental de expirados
+    uint64_t deadBytes;
+    uint64_t liveBytes;   // Bytes almacenados (comprimidos) de las entradas vivas
+    uint64_t rawBytes;    // Los mismos, sin comprimir
+    uint32_t compressedCount; // Entradas vivas guardadas con códec
+    uint32_t reserved0;
+    uint64_t accessTotal; // Suma de accessCount de las vivas
+    int64_t minExpiry;    // Cota inferior de la expiración de las vivas: now < minExpiry => ninguna caducada
+};
+static_assert(sizeof(CacheShardHeader) == 64, "cabecera de shard debe ocupar 64 bytes");
+
+struct CacheSlot {
+    CacheKey key;         // 128 bits binarios
+    int64_t expiry;       // segundos unix
+    uint64_t offset;      // posición en la región de datos
+    uint32_t length;      // bytes almacenados
+    uint32_t accessCount;
+    uint16_t state;
+    uint8_t referenced;   // bit de uso para CLOCK
+    uint8_t codec;        // CODEC_NONE / ZLIB / LZ4 / ZSTD
+    uint32_t rawLength;   // tamaño original del valor
+};
+static_assert(sizeof(CacheSlot) == 48, "slot de cache debe ocupar 48 bytes");
+
+struct CacheStats {
+    int total = 0;
+    int valid = 0;
+    int expired = 0;
+    long long totalAccess = 0;
+    int compressed = 0;       // Entradas guardadas comprimidas
+    uint64_t bytes = 0;       // Datos vivos tal como ocupan en el archivo
+    uint64_t rawBytes = 0;    // Datos vivos sin comprimir
+    uint64_t fileBytes = 0;   // Tamaño del archivo mapeado (incluye índice y huecos)
+    uint64_t byteBudget = 0;  // 0 = sin límite de bytes
+};
+
+// Ruta por defecto del archivo de cache (OLLAMA_CACHE_FILE o home del usuario)
+inline std::string defaultCachePath() {
+    const char* env = std::getenv("OLLAMA_CACHE_FILE");
+    if (env && *env) {
+        return env;
+    }
+#ifdef _WIN32
+    const char* home = std::getenv("USERPROFILE");
+#else
+    const char* home = std::getenv("HOME");
+#endif
+    if (home && *home) {
+        return std::string(home) + "/.ollama_cache.bin";
+    }
+    return "ollama_cache.bin";
+}
+
+// Presupuesto de bytes: OLLAMA_CACHE_MAX_BYTES admite sufijos K, M y G (0 = sin límite)
+inline uint64_t defaultCacheMaxBytes() {
+    const char* env = std::getenv("OLLAMA_CACHE_MAX_BYTES");
+    if (!env || !*env) {
+        return CACHE_DEFAULT_MAX_BYTES;
+    }
+    char* end = nullptr;
+    uint64_t n = std::strtoull(env, &end, 10);
+    switch (end ? *end : 0) {
+        case 'k': case 'K': return n << 10;
+        case 'm': case 'M': return n << 20;
+        case 'g': case 'G': return n << 30;
+        default: return n;
+    }
+}
+
+inline int64_t cacheNow() {
+    return std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// Cache persistente mapeado en memoria, particionado en shards con lock propio.
+// Orden de locks: mapa (compartido) -> shard -> datos, igual en hilos y en procesos.
+// Solo crecer/compactar/vaciar el archivo toma el mapa en exclusiva.
+class PersistentCache {
+private:
+    MappedFile file;
+    std::shared_mutex mapMutex;
+    std::vector<std::mutex> shardLocks;
+    std::mutex dataMutex;
+    std::mutex fileSharedMutex;
+    uint32_t fileSharedHolders = 0; // Hilos con el mapa compartido: el lock de archivo es uno por proceso
+    uint32_t slotsPerShard;
+    uint32_t maxPerShard;
+    uint64_t maxBytes;
+    uint64_t maxBytesPerShard;
+
+    CacheFileHeader* header() { return reinterpret_cast<CacheFileHeader*>(file.data()); }
+
+    CacheShardHeader* shardHeader(uint32_t sh) {
+        return reinterpret_cast<CacheShardHeader*>(file.data() + sizeof(CacheFileHeader)) + sh;
+    }
+
+    CacheSlot* shardSlots(uint32_t sh) {
+        char* base = file.data() + sizeof(CacheFileHeader) + CACHE_SHARDS * sizeof(CacheShardHeader);
+        return reinterpret_cast<CacheSlot*>(base) + static_cast<size_t>(sh) * slotsPerShard;
+    }
+
+    uint64_t dataStart() const {
+        return sizeof(CacheFileHeader) + CACHE_SHARDS * sizeof(CacheShardHeader) +
+               static_cast<uint64_t>(CACHE_SHARDS) * slotsPerShard * sizeof(CacheSlot);
+    }
+
+    static uint32_t shardOf(uint64_t h) { return static_cast<uint32_t>(h % CACHE_SHARDS); }
+
+    uint32_t probe(uint64_t h, uint32_t i) const {
+        return static_cast<uint32_t>(((h / CACHE_SHARDS) % slotsPerShard + i) % slotsPerShard);
+    }
+
+    void initialize() {
+        std::memset(file.data(), 0, static_cast<size_t>(dataStart()));
+        CacheFileHeader* h = header();
+        std::memcpy(h->magic, CACHE_FILE_MAGIC, sizeof(h->magic));
+        h->version = CACHE_FILE_VERSION;
+        h->shardCount = CACHE_SHARDS;
+        h->slotsPerShard = slotsPerShard;
+        h->dataOffset = dataStart();
+        h->dataEnd = dataStart();
+        h->fileBytes = file.size();
+    }
+
+    // Un archivo válido manda sobre la configuración del proceso: todos usan su geometría
+    void adoptGeometry() {
+        if (file.data() == nullptr || file.size() < sizeof(CacheFileHeader)) return;
+        CacheFileHeader* h = header();
+        if (std::memcmp(h->magic, CACHE_FILE_MAGIC, sizeof(h->magic)) != 0) return;
+        if (h->version != CACHE_FILE_VERSION || h->shardCount != CACHE_SHARDS || h->slotsPerShard < 2) return;
+        slotsPerShard = h->slotsPerShard;
+        maxPerShard = slotsPerShard / 2;
+    }
+
+    bool headerValid() {
+        if (file.data() == nullptr || file.size() < dataStart()) return false;
+        CacheFileHeader* h = header();
+        if (std::memcmp(h->magic, CACHE_FILE_MAGIC, sizeof(h->magic)) != 0) return false;
+        if (h->version != CACHE_FILE_VERSION) return false;
+        if (h->shardCount != CACHE_SHARDS || h->slotsPerShard != slotsPerShard) return false;
+        if (h->dataOffset != dataStart()) return false;
+        if (h->dataEnd < h->dataOffset || h->dataEnd > file.size()) return false;
+        return true;
+    }
+
+    // Ponerse al día con el archivo (mapa en exclusiva entre hilos y procesos): otro proceso pudo
+    // crecerlo, vaciarlo o crearlo. Sin cambios de tamaño no hay que remapear.
+    bool attachExclusive() {
+        if (file.data() != nullptr && header()->fileBytes == file.size() && headerValid()) {
+            return true;
+        }
+        if (!file.remap()) {
+            return false;
+        }
+        adoptGeometry();
+        if (!headerValid()) {
+            uint64_t minSize = dataStart() + CACHE_DATA_INITIAL;
+            if (file.size() < minSize && !file.resize(minSize)) {
+                return false;
+            }
+            initialize();
+        }
+        header()->fileBytes = file.size();
+        return true;
+    }
+
+    // Mapa en exclusiva: mapMutex único y byte CACHE_LOCK_MAP exclusivo, ya al día con el archivo
+    class ExclusiveMap {
+    private:
+        PersistentCache& cache;
+        std::unique_lock<std::shared_mutex> lock;
+        bool locked = false;
+        bool attached = false;
+
+    public:
+        explicit ExclusiveMap(PersistentCache& c) : cache(c), lock(c.mapMutex) {
+            if (!cache.file.isOpen() || !cache.file.lockRange(CACHE_LOCK_MAP, true)) return;
+            locked = true;
+            attached = cache.attachExclusive();
+        }
+        ~ExclusiveMap() {
+            if (locked) cache.file.unlockRange(CACHE_LOCK_MAP);
+        }
+        explicit operator bool() const { return attached; }
+    };
+
+    // Mapa compartido: mapMutex compartido y, una vez por proceso, byte CACHE_LOCK_MAP compartido.
+    // Si otro proceso cambió el tamaño del archivo se remapea en exclusiva y se reintenta.
+    class SharedMap {
+    private:
+        PersistentCache& cache;
+        std::shared_lock<std::shared_mutex> lock;
+        bool held = false;
+
+        void holdFile() {
+            std::lock_guard<std::mutex> guard(cache.fileSharedMutex);
+            if (cache.fileSharedHolders++ == 0) cache.file.lockRange(CACHE_LOCK_MAP, false);
+        }
+
+        void releaseFile() {
+            std::lock_guard<std::mutex> guard(cache.fileSharedMutex);
+            if (--cache.fileSharedHolders == 0) cache.file.unlockRange(CACHE_LOCK_MAP);
+        }
+
+    public:
+        explicit SharedMap(PersistentCache& c) : cache(c) {
+            while (true) {
+                lock = std::shared_lock<std::shared_mutex>(cache.mapMutex);
+                if (!cache.isOpen()) return;
+                holdFile();
+                if (cache.header()->fileBytes == cache.file.size()) {
+                    held = true;
+                    return;
+                }
+                releaseFile();
+                lock.unlock();
+                ExclusiveMap exclusive(cache);
+                if (!exclusive) return;
+            }
+        }
+        ~SharedMap() {
+            if (held) releaseFile();
+        }
+        explicit operator bool() const { return held; }
+    };
+
+    // Shard en exclusiva: su mutex en el proceso y el byte CACHE_LOCK_SHARD + sh entre procesos
+    class ShardLock {
+    private:
+        PersistentCache& cache;
+        uint32_t sh;
+
+    public:
+        ShardLock(PersistentCache& c, uint32_t s) : cache(c), sh(s) {
+            cache.shardLocks[sh].lock();
+            cache.file.lockRange(CACHE_LOCK_SHARD + sh, true);
+        }
+        ~ShardLock() {
+            cache.file.unlockRange(CACHE_LOCK_SHARD + sh);
+            cache.shardLocks[sh].unlock();
+        }
+    };
+
+    // Buscar slot de una clave dentro de su shard; devuelve -1 si no existe
+    long findLocked(uint32_t sh, const CacheKey& key, uint64_t h) {
+        CacheSlot* s = shardSlots(sh);
+        for (uint32_t i = 0; i < slotsPerShard; ++i) {
+            uint32_t idx = probe(h, i);
+            if (s[idx].state == SLOT_EMPTY) {
+                return -1;
+            }
+            if (s[idx].state == SLOT_USED && s[idx].key == key) {
+                return idx;
+            }
+        }
+        return -1;
+    }
+
+    void eraseLocked(uint32_t sh, uint32_t idx) {
+        CacheSlot& slot = shardSlots(sh)[idx];
+        CacheShardHeader* sht = shardHeader(sh);
+        sht->deadBytes += slot.length;
+        sht->liveBytes -= slot.length;
+        sht->rawBytes -= slot.rawLength;
+        sht->accessTotal -= slot.accessCount;
+        if (slot.codec != CODEC_NONE) sht->compressedCount--;
+        sht->entryCount--;
+        sht->tombstoneCount++;
+        slot.state = SLOT_DELETED;
+    }
+
+    // Expulsar una entrada con CLOCK: coste O(1) amortizado, prioriza las expiradas
+    bool evictOneLocked(uint32_t sh, int64_t now) {
+        CacheSlot* s = shardSlots(sh);
+        CacheShardHeader* sht = shardHeader(sh);
+        for (uint32_t step = 0; step < 2 * slotsPerShard; ++step) {
+            uint32_t idx = sht->clockHand % slotsPerShard;
+            sht->clockHand = (idx + 1) % slotsPerShard;
+            if (s[idx].state != SLOT_USED) {
+                continue;
+            }
+            if (now < s[idx].expiry && s[idx].referenced) {
+                s[idx].referenced = 0;
+                continue;
+            }
+            eraseLocked(sh, idx);
+            return true;
+        }
+        return false;
+    }
+
+    // Barrido incremental: revisar 'budget' slots desde sweepHand y borrar los expirados.
+    // Junto con la expiración al consultar, nadie tiene que recorrer el archivo entero.
+    uint32_t sweepLocked(uint32_t sh, int64_t now, uint32_t budget) {
+        CacheSlot* s = shardSlots(sh);
+        CacheShardHeader* sht = shardHeader(sh);
+        uint32_t erased = 0;
+        for (uint32_t step = 0; step < budget && step < slotsPerShard; ++step) {
+            uint32_t idx = sht->sweepHand % slotsPerShard;
+            sht->sweepHand = (idx + 1) % slotsPerShard;
+            if (s[idx].state == SLOT_USED && now >= s[idx].expiry) {
+                eraseLocked(sh, idx);
+                erased++;
+            }
+        }
+        return erased;
+    }
+
+    // El shard no admite 'len' bytes más sin pasarse de entradas o de presupuesto
+    bool overBudgetLocked(uint32_t sh, uint64_t len) {
+        CacheShardHeader* sht = shardHeader(sh);
+        if (sht->entryCount == 0) {
+            return false;
+        }
+        return sht->entryCount >= maxPerShard ||
+               (maxBytesPerShard > 0 && sht->liveBytes + len > maxBytesPerShard);
+    }
+
+    // Reconstruir el índice del shard cuando hay demasiadas lápidas
+    void rehashLocked(uint32_t sh) {
+        std::vector<CacheSlot> live;
+        CacheSlot* s = shardSlots(sh);
+        for (uint32_t i = 0; i < slotsPerShard; ++i) {
+            if (s[i].state == SLOT_USED) {
+                live.push_back(s[i]);
+            }
+        }
+        std::memset(s, 0, static_cast<size_t>(slotsPerShard) * sizeof(CacheSlot));
+        CacheShardHeader* sht = shardHeader(sh);
+        sht->minExpiry = 0;
+        for (const auto& slot : live) {
+            if (sht->minExpiry == 0 || slot.expiry < sht->minExpiry) sht->minExpiry = slot.expiry;
+            uint64_t h = slot.key.prefix();
+            for (uint32_t i = 0; i < slotsPerShard; ++i) {
+                uint32_t idx = probe(h, i);
+                if (s[idx].state == SLOT_EMPTY) {
+                    s[idx] = slot;
+                    break;
+                }
+            }
+        }
+        sht->tombstoneCount = 0;
+    }
+
+    // Insertar en el shard (lock del shard tomado); 'offset' ya reservado en la región de datos.
+    // 'stored' son los bytes a escribir (comprimidos o no) y 'rawLength' el tamaño original.
+    void insertLocked(uint32_t sh, const CacheKey& key, uint64_t h, const char* stored, size_t len,
+                      uint8_t codec, size_t rawLength, uint64_t offset, int ttlSeconds) {
+        int64_t now = cacheNow();
+        CacheShardHeader* sht = shardHeader(sh);
+        long existing = findLocked(sh, key, h);
+        if (existing >= 0) {
+            eraseLocked(sh, static_cast<uint32_t>(existing));
+        }
+        sweepLocked(sh, now, CACHE_SWEEP_PER_INSERT);
+        // Expulsar hasta caber en número de entradas y en bytes
+        while (overBudgetLocked(sh, len) && evictOneLocked(sh, now)) {
+        }
+        if (sht->tombstoneCount > slotsPerShard / 4) {
+            rehashLocked(sh);
+        }
+
+        CacheSlot* s = shardSlots(sh);
+        for (uint32_t i = 0; i < slotsPerShard; ++i) {
+            uint32_t idx = probe(h, i);
+            if (s[idx].state == SLOT_USED) {
+                continue;
+            }
+            if (s[idx].state == SLOT_DELETED) {
+                sht->tombstoneCount--;
+            }
+            CacheSlot& slot = s[idx];
+            slot.key = key;
+            slot.expiry = now + ttlSeconds;
+            slot.offset = offset;
+            slot.length = static_cast<uint32_t>(len);
+            slot.rawLength = static_cast<uint32_t>(rawLength);
+            slot.codec = codec;
+            slot.accessCount = 1;
+            slot.referenced = 0;
+            slot.state = SLOT_USED;
+            std::memcpy(file.data() + offset, stored, len);
+            if (sht->entryCount == 0 || slot.expiry < sht->minExpiry) sht->minExpiry = slot.expiry;
+            sht->entryCount++;
+            sht->liveBytes += len;
+            sht->rawBytes += rawLength;
+            sht->accessTotal += 1;
+            if (codec != CODEC_NONE) sht->compressedCount++;
+            return;
+        }
+    }
+
+    // Reservar espacio al final de la región de datos; false si hay que crecer
+    bool allocData(uint64_t len, uint64_t& offset) {
+        std::lock_guard<std::mutex> lock(dataMutex);
+        file.lockRange(CACHE_LOCK_DATA, true);
+        bool fits = header()->dataEnd + len <= file.size();
+        if (fits) {
+            offset = header()->dataEnd;
+            header()->dataEnd += len;
+        }
+        file.unlockRange(CACHE_LOCK_DATA);
+        return fits;
+    }
+
+    uint64_t deadBytesTotal() {
+        uint64_t dead = 0;
+        for (uint32_t sh = 0; sh < CACHE_SHARDS; ++sh) {
+            dead += shardHeader(sh)->deadBytes;
+        }
+        return dead;
+    }
+
+    // Mover los datos vivos al inicio de la región de datos (requiere el mapa en exclusiva)
+    void compactExclusive() {
+        std::vector<CacheSlot*> order;
+        for (uint32_t sh = 0; sh < CACHE_SHARDS; ++sh) {
+            CacheSlot* s = shardSlots(sh);
+            for (uint32_t i = 0; i < slotsPerShard; ++i) {
+                if (s[i].state == SLOT_USED) {
+                    order.push_back(&s[i]);
+                }
+            }
+            shardHeader(sh)->deadBytes = 0;
+        }
+        std::sort(order.begin(), order.end(),
+                  [](const CacheSlot* a, const CacheSlot* b) { return a->offset < b->offset; });
+
+        uint64_t w = header()->dataOffset;
+        for (CacheSlot* slot : order) {
+            if (slot->offset != w) {
+                std::memmove(file.data() + w, file.data() + slot->offset, slot->length);
+                slot->offset = w;
+            }
+            w += slot->length;
+        }
+        header()->dataEnd = w;
+    }
+
+    // Compactar o crecer hasta que quepan 'len' bytes (requiere el mapa en exclusiva)
+    bool growExclusive(uint64_t len) {
+        if (header()->dataEnd + len <= file.size()) {
+            return true;
+        }
+        uint64_t used = header()->dataEnd - header()->dataOffset;
+        if (deadBytesTotal() * 2 >= used) {
+            compactExclusive();
+            if (header()->dataEnd + len <= file.size()) {
+                return true;
+            }
+        }
+        uint64_t newSize = file.size();
+        while (header()->dataEnd + len > newSize) {
+            newSize *= 2;
+        }
+        if (!file.resize(newSize)) {
+            return false;
+        }
+        header()->fileBytes = file.size();
+        return true;
+    }
+
+    // Leer el slot de una clave (mapa compartido tomado): en claro a 'value', comprimido a 'packed'
+    bool readSlot(const CacheKey& key, std::string& value, std::string& packed, uint8_t& codec, size_t& rawLength) {
+        uint64_t h = key.prefix();
+        uint32_t sh = shardOf(h);
+        ShardLock lock(*this, sh);
+        long idx = findLocked(sh, key, h);
+        if (idx < 0) {
+            return false;
+        }
+        CacheSlot& slot = shardSlots(sh)[idx];
+        if (cacheNow() >= slot.expiry) {
+            eraseLocked(sh, static_cast<uint32_t>(idx));
+            return false;
+        }
+        slot.accessCount++;
+        slot.referenced = 1;
+        shardHeader(sh)->accessTotal++;
+        codec = slot.codec;
+        rawLength = slot.rawLength;
+        (codec == CODEC_NONE ? value : packed).assign(file.data() + slot.offset, slot.length);
+        return true;
+    }
+
+public:
+    // 'maxSize' entradas como máximo y, si 'maxBytesTotal' > 0, ese presupuesto de datos vivos
+    // (repartido por igual entre shards; cada shard expulsa con CLOCK al pasarse).
+    // Si el archivo ya existe con otra geometría válida, se usa la suya y 'maxSize' se ignora.
+    PersistentCache(const std::string& path, uint32_t maxSize, uint64_t maxBytesTotal = 0)
+        : shardLocks(CACHE_SHARDS), maxBytes(maxBytesTotal), maxBytesPerShard(maxBytesTotal / CACHE_SHARDS) {
+        maxPerShard = std::max<uint32_t>(1, (maxSize + CACHE_SHARDS - 1) / CACHE_SHARDS);
+        slotsPerShard = maxPerShard * 2;
+        uint64_t minSize = dataStart() + CACHE_DATA_INITIAL;
+        if (!file.open(path, minSize)) {
+            return;
+        }
+        // Validar o inicializar en exclusiva: dos procesos que arrancan a la vez no lo hacen los dos
+        ExclusiveMap exclusive(*this);
+        if (!exclusive) {
+            file.close();
+        }
+    }
+
+    bool isOpen() const { return file.data() != nullptr; }
+
+    // Obtener valor válido; los expirados se eliminan al consultarlos.
+    // Los comprimidos se copian bajo el lock y se descomprimen fuera de él.
+    bool get(const CacheKey& key, std::string& value) {
+        thread_local std::string packed;
+        uint8_t codec = CODEC_NONE;
+        size_t rawLength = 0;
+        {
+            SharedMap map(*this);
+            if (!map) return false;
+            if (!readSlot(key, value, packed, codec, rawLength)) {
+                return false;
+            }
+        }
+        if (codec == CODEC_NONE) {
+            return true;
+        }
+        return decompressValue(codec, packed.data(), packed.size(), rawLength, value);
+    }
+
+    // Guardar valor con expiración (en segundos); comprime si compensa y expulsa con CLOCK
+    // si el shard está lleno o por encima de su presupuesto de bytes
+    void put(const CacheKey& key, const std::string& value, int ttlSeconds) {
+        uint64_t h = key.prefix();
+        uint32_t sh = shardOf(h);
+
+        thread_local std::string packed;
+        uint8_t codec = compressValue(value.data(), value.size(), packed);
+        const char* stored = codec == CODEC_NONE ? value.data() : packed.data();
+        size_t len = codec == CODEC_NONE ? value.size() : packed.size();
+        if (maxBytesPerShard > 0 && len > maxBytesPerShard) {
+            return; // Más grande que el shard entero: vaciarlo por él no tiene sentido
+        }
+
+        while (true) {
+            {
+                SharedMap map(*this);
+                if (!map) return;
+
+                uint64_t offset = 0;
+                if (allocData(len, offset)) {
+                    ShardLock lock(*this, sh);
+                    insertLocked(sh, key, h, stored, len, codec, value.size(), offset, ttlSeconds);
+                    return;
+                }
+            }
+            ExclusiveMap exclusive(*this);
+            if (!exclusive || !growExclusive(len)) {
+                return;
+            }
+        }
+    }
+
+    // Pasada completa de expirados (mantenimiento explícito, p. ej. 'optimize'). No hace falta
+    // para que el cache funcione: put() barre un poco en cada inserción y get() borra el expirado
+    // que encuentra. El lock de cada shard se suelta cada CACHE_SWEEP_CHUNK slots.
+    size_t cleanup() {
+        SharedMap map(*this);
+        if (!map) return 0;
+
+        int64_t now = cacheNow();
+        size_t erased = 0;
+        for (uint32_t sh = 0; sh < CACHE_SHARDS; ++sh) {
+            for (uint32_t done = 0; done < slotsPerShard; done += CACHE_SWEEP_CHUNK) {
+                ShardLock lock(*this, sh);
+                erased += sweepLocked(sh, now, std::min(CACHE_SWEEP_CHUNK, slotsPerShard - done));
+            }
+            ShardLock lock(*this, sh);
+            if (shardHeader(sh)->tombstoneCount > slotsPerShard / 4) {
+                rehashLocked(sh);
+            }
+        }
+        return erased;
+    }
+
+    void clear() {
+        ExclusiveMap exclusive(*this);
+        if (!exclusive) return;
+        file.resize(dataStart() + CACHE_DATA_INITIAL);
+        initialize();
+    }
+
+    size_t size() {
+        SharedMap map(*this);
+        if (!map) return 0;
+        size_t total = 0;
+        for (uint32_t sh = 0; sh < CACHE_SHARDS; ++sh) {
+            ShardLock lock(*this, sh);
+            total += shardHeader(sh)->entryCount;
+        }
+        return total;
+    }
+
+    // Estadísticas desde las cabeceras de shard: O(1) por shard. Solo se recorren los slots de
+    // un shard cuando puede tener entradas caducadas (now >= minExpiry), y de paso se ajusta la cota.
+    CacheStats stats() {
+        SharedMap map(*this);
+        CacheStats st;
+        if (!map) return st;
+
+        st.fileBytes = file.size();
+        st.byteBudget = maxBytes;
+        int64_t now = cacheNow();
+        for (uint32_t sh = 0; sh < CACHE_SHARDS; ++sh) {
+            ShardLock lock(*this, sh);
+            CacheShardHeader* sht = shardHeader(sh);
+            st.total += static_cast<int>(sht->entryCount);
+            st.compressed += static_cast<int>(sht->compressedCount);
+            st.totalAccess += static_cast<long long>(sht->accessTotal);
+            st.bytes += sht->liveBytes;
+            st.rawBytes += sht->rawBytes;
+            if (sht->entryCount == 0 || now < sht->minExpiry) {
+                st.valid += static_cast<int>(sht->entryCount);
+                continue;
+            }
+            CacheSlot* s = shardSlots(sh);
+            sht->minExpiry = 0;
+            for (uint32_t i = 0; i < slotsPerShard; ++i) {
+                if (s[i].state != SLOT_USED) {
+                    continue;
+                }
+                if (sht->minExpiry == 0 || s[i].expiry < sht->minExpiry) sht->minExpiry = s[i].expiry;
+                if (now < s[i].expiry) {
+                    st.valid++;
+                } else {
+                    st.expired++;
+                }
+            }
+        }
+        return st;
+    }
+};
@@ -1,343 +1,1094 @@
 #include <iostream>
 #include <string>
-#include <map>
 #include <chrono>
-#include <thread>
-#include <future>
-#include <curl/curl.h>
-#include <nlohmann/json.hpp>
-#include <openssl/sha.h>
 #include <iomanip>
+#include <fstream>
+#include <atomic>
+#include <csignal>
 #include <sstream>
+#include <filesystem>
+#include <set>
+#include "ollama_client.hpp"
+#include "ollama_context.hpp"
+#include "ollama_daemon.hpp"
+#include "ollama_mock.hpp"
+#include "ollama_profile.hpp"
 
-using json = nlohmann::json;
+// Modo de salida: humano (por defecto), --quiet (solo el texto) o --json (una línea JSON por resultado)
+enum class OutputMode { Human, Quiet, Json };
+OutputMode outputMode = OutputMode::Human;
+bool daemonForwarding = true; // false con --local
 
-// Configuración por defecto
-const std::string DEFAULT_MODEL = "codellama:7b-code-q4_K_M";
-const std::string DEFAULT_ENDPOINT = "http://localhost:11434";
-const int DEFAULT_TIMEOUT = 30;
-const int CACHE_EXPIRY = 3600; // 1 hora
-
-// Estructura para cache
-struct CacheEntry {
-    json response;
-    std::chrono::system_clock::time_point expiry;
-};
+inline std::string dumpLine(const json& rec) {
+    return rec.dump(-1, ' ', false, json::error_handler_t::replace) + '\n';
+}
 
-// Cache global
-std::map<std::string, CacheEntry> ollamaCache;
+// Cabecera antes de la consulta (solo modo humano; se vacía el buffer para verla mientras espera)
+void printQuestion(const std::string& question, bool fast) {
+    if (outputMode == OutputMode::Human) {
+        std::cout << (fast ? "⚡ Pregunta rápida: " : "🤖 Ollama: ") << question << "\n\n" << std::flush;
+    }
+}
 
-// Función para generar hash SHA256
-std::string generateHash(const std::string& prompt, const std::string& model) {
-    std::string content = prompt + "|" + model;
-    unsigned char hash[SHA256_DIGEST_LENGTH];
-    SHA256_CTX sha256;
-    SHA256_Init(&sha256);
-    SHA256_Update(&sha256, content.c_str(), content.length());
-    SHA256_Final(hash, &sha256);
-    
-    std::stringstream ss;
-    for(int i = 0; i < SHA256_DIGEST_LENGTH; i++) {
-        ss << std::hex << std::setw(2) << std::setfill('0') << static_cast<int>(hash[i]);
+// Un resultado de ask/fast: una sola escritura al buffer de salida, sin std::endl
+void printResult(const std::string& question, const QueryResult& r, bool fast) {
+    if (outputMode == OutputMode::Json) {
+        json rec = {{"prompt", question}, {"cached", r.cached}, {"latency_ms", r.ms}};
+        if (r.reply.ok) {
+            rec["response"] = r.reply.response();
+        } else {
+            rec["error"] = r.reply.error.empty() ? "sin respuesta" : r.reply.error;
+        }
+        if (r.coalesced) {
+            rec["coalesced"] = true;
+        }
+        if (r.similarity > 0) {
+            rec["similarity"] = r.similarity;
+        }
+        if (r.reply.evalCount > 0) {
+            rec["eval_count"] = r.reply.evalCount;
+        }
+        std::cout << dumpLine(rec);
+        return;
+    }
+    if (!r.reply.ok) {
+        std::cerr << "❌ Error: " << (r.reply.error.empty() ? "sin respuesta" : r.reply.error) << std::endl;
+        return;
+    }
+    std::string out(r.reply.response());
+    out += '\n';
+    if (outputMode == OutputMode::Quiet) {
+        std::cout << out;
+        return;
+    }
+    if (r.cached && r.similarity > 0) {
+        char score[16];
+        std::snprintf(score, sizeof(score), "%.3f", r.similarity);
+        out = std::string("🧠 Respuesta de una pregunta parecida (similitud ") + score + "):\n" + out +
+              (fast ? "\n⚡ Cache hit - tiempo instantáneo\n" : "\n⏱️  Cache hit - tiempo instantáneo\n");
+    } else if (r.cached) {
+        out = std::string(fast ? "⚡ Respuesta rápida desde cache:\n" : "⚡ Respuesta desde cache:\n") + out +
+              (fast ? "\n⚡ Cache hit - tiempo instantáneo\n" : "\n⏱️  Cache hit - tiempo instantáneo\n");
+    } else {
+        out = std::string(fast ? "✅ Respuesta rápida:\n" : "✅ Respuesta:\n") + out +
+              (fast ? "\n⚡ Tiempo: " : "\n⏱️  Tiempo: ") + std::to_string(r.ms) + "ms\n";
     }
-    return ss.str();
+    std::cout << out;
 }
 
-// Callback para CURL
-size_t WriteCallback(void* contents, size_t size, size_t nmemb, std::string* userp) {
-    userp->append((char*)contents, size * nmemb);
-    return size * nmemb;
+void printCacheStats(const CacheStats& st) {
+    if (outputMode == OutputMode::Json) {
+        std::cout << dumpLine({{"total", st.total}, {"valid", st.valid}, {"expired", st.expired},
+                               {"compressed", st.compressed}, {"bytes", st.bytes}, {"raw_bytes", st.rawBytes},
+                               {"file_bytes", st.fileBytes}, {"byte_budget", st.byteBudget}});
+        return;
+    }
+    std::cout << "📊 Estadísticas de Cache:\n"
+              << "   Total: " << st.total << " elementos\n"
+              << "   Válidos: " << st.valid << "\n"
+              << "   Expirados: " << st.expired << "\n"
+              << "   Comprimidos: " << st.compressed << " (" << codecName(CODEC_DEFAULT) << ")\n"
+              << "   Datos: " << st.bytes << " bytes (" << st.rawBytes << " sin comprimir)\n"
+              << "   Archivo: " << st.fileBytes / 1024 << " KB\n";
+    if (st.byteBudget > 0) {
+        std::cout << "   Presupuesto: " << st.byteBudget / 1024 << " KB\n";
+    }
 }
 
-// Cliente principal de Ollama
-class OllamaClient {
-private:
-    std::string model;
-    std::string endpoint;
-    int timeout;
-    
-public:
-    OllamaClient(const std::string& m = DEFAULT_MODEL, 
-                 const std::string& ep = DEFAULT_ENDPOINT, 
-                 int t = DEFAULT_TIMEOUT) 
-        : model(m), endpoint(ep), timeout(t) {
-        curl_global_init(CURL_GLOBAL_DEFAULT);
+// Ejecutar un archivo JSONL de prompts con concurrencia limitada; resultados en orden de llegada
+int runBatch(OllamaClient& client, const std::string& inPath, const std::string& outPath, size_t concurrency) {
+    std::ifstream in(inPath);
+    if (!in.is_open()) {
+        std::cerr << "❌ Error: No se pudo abrir " << inPath << std::endl;
+        return 1;
     }
-    
-    ~OllamaClient() {
-        curl_global_cleanup();
+    std::ofstream outFile;
+    if (!outPath.empty()) {
+        outFile.open(outPath);
+        if (!outFile.is_open()) {
+            std::cerr << "❌ Error: No se pudo crear " << outPath << std::endl;
+            return 1;
+        }
     }
+    std::ostream& out = outPath.empty() ? std::cout : outFile;
     
-    // Llamada síncrona con cache
-    json ask(const std::string& question, bool useCache = true) {
-        std::cout << "🤖 Ollama: " << question << std::endl << std::endl;
-        
-        // Verificar cache
-        if (useCache) {
-            std::string hash = generateHash(question, model);
-            auto it = ollamaCache.find(hash);
-            if (it != ollamaCache.end()) {
-                auto now = std::chrono::system_clock::now();
-                if (now < it->second.expiry) {
-                    std::cout << "⚡ Respuesta desde cache:" << std::endl;
-                    std::cout << it->second.response["response"] << std::endl;
-                    std::cout << std::endl << "⏱️  Cache hit - tiempo instantáneo" << std::endl;
-                    return it->second.response;
-                } else {
-                    ollamaCache.erase(it);
+    std::mutex outMutex;
+    std::atomic<int> total{0};
+    std::atomic<int> hits{0};
+    std::atomic<int> shared{0};
+    std::atomic<int> similar{0};
+    std::atomic<int> errors{0};
+    auto start = std::chrono::high_resolution_clock::now();
+    
+    auto writeRecord = [&](const json& rec) {
+        std::string text = dumpLine(rec);
+        std::lock_guard<std::mutex> lock(outMutex);
+        out << text;
+    };
+    
+    {
+        // La cola acotada frena la lectura del archivo: nunca hay más de 2*N prompts en memoria
+        ThreadPool workers(concurrency, concurrency * 2);
+        std::string line;
+        long lineNo = 0;
+        while (std::getline(in, line)) {
+            lineNo++;
+            if (line.empty() || line == "\r") {
+                continue;
+            }
+            total++;
+            
+            json item = json::parse(line, nullptr, false);
+            json id = lineNo;
+            std::string prompt;
+            bool fast = false;
+            if (item.is_object() && item.contains("prompt") && item["prompt"].is_string()) {
+                prompt = item["prompt"].get<std::string>();
+                fast = item.value("fast", false);
+                if (item.contains("id")) {
+                    id = item["id"];
                 }
+            } else if (item.is_string()) {
+                prompt = item.get<std::string>();
+            } else {
+                errors++;
+                writeRecord({{"id", id}, {"error", "línea JSONL inválida"}});
+                continue;
             }
+            
+            workers.submit([&client, &writeRecord, &hits, &shared, &similar, &errors, id, prompt, fast]() {
+                // Con daemon, cada hilo le reenvía por su conexión: allí compite como lote con
+                // las preguntas interactivas de otros procesos en el mismo planificador
+                thread_local DaemonClient daemon;
+                thread_local bool connectTried = false;
+                if (daemonForwarding && !connectTried) {
+                    connectTried = true;
+                    daemon.connect();
+                }
+                QueryResult r;
+                if (!daemon.connected() || !daemon.query(prompt, fast, client.getModel(), r, Priority::Batch)) {
+                    r = client.query(prompt, fast ? FAST_OPTIONS : ASK_OPTIONS, true, Priority::Batch);
+                }
+                json rec = {{"id", id}, {"cached", r.cached}, {"latency_ms", r.ms}};
+                if (!r.reply.ok) {
+                    errors++;
+                    rec["error"] = r.reply.error.empty() ? "sin respuesta" : r.reply.error;
+                } else {
+                    rec["response"] = r.reply.response();
+                }
+                if (r.cached) {
+                    hits++;
+                }
+                if (r.coalesced) {
+                    shared++;
+                    rec["coalesced"] = true;
+                }
+                if (r.similarity > 0) {
+                    similar++;
+                    rec["similarity"] = r.similarity;
+                }
+                writeRecord(rec);
+            });
         }
-        
-        // Preparar datos
-        json data = {
-            {"model", model},
-            {"prompt", question},
-            {"stream", false},
-            {"options", {
-                {"temperature", 0.7},
-                {"num_predict", 100},
-                {"top_k", 40},
-                {"top_p", 0.9},
-                {"repeat_penalty", 1.1}
-            }}
-        };
-        
-        auto start = std::chrono::high_resolution_clock::now();
-        
-        // Realizar llamada HTTP
-        json response = makeRequest(data);
-        
-        auto end = std::chrono::high_resolution_clock::now();
-        auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
-        
-        // Guardar en cache
-        if (useCache && !response.empty()) {
-            std::string hash = generateHash(question, model);
-            CacheEntry entry;
-            entry.response = response;
-            entry.expiry = std::chrono::system_clock::now() + std::chrono::seconds(CACHE_EXPIRY);
-            ollamaCache[hash] = entry;
+    } // El pool espera a que terminen todas las tareas
+    out.flush();
+    
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::high_resolution_clock::now() - start).count();
+    if (outputMode != OutputMode::Human) {
+        return errors > 0 ? 1 : 0;
+    }
+    std::cerr << "📦 Batch: " << total << " prompts, " << hits << " desde cache";
+    if (similar > 0) {
+        std::cerr << " (" << similar << " por similitud)";
+    }
+    std::cerr << ", "
+              << shared << " compartidos, "
+              << errors << " errores, " << ms << "ms";
+    if (ms > 0) {
+        std::cerr << " (" << std::fixed << std::setprecision(1) << total * 1000.0 / ms << " prompts/s)";
+    }
+    std::cerr << std::endl;
+    unsigned long long hedges = 0, hedgesWon = 0;
+    client.hedgeCounts(hedges, hedgesWon);
+    if (hedges > 0) {
+        std::cerr << "🪞 " << hedges << " copias de respaldo enviadas, " << hedgesWon << " respondieron antes" << std::endl;
+    }
+    return errors > 0 ? 1 : 0;
+}
+
+// Un turno de sesión con salida por consola; guarda la sesión tras cada respuesta
+bool runSessionTurn(OllamaClient& client, Session& session, const std::string& question) {
+    auto start = std::chrono::high_resolution_clock::now();
+    GenerateReply reply = client.chat(session, question);
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::high_resolution_clock::now() - start).count();
+    if (outputMode == OutputMode::Json) {
+        json rec = {{"session", session.name}, {"turn", session.turns}, {"latency_ms", ms},
+                    {"context_tokens", session.context.size()}};
+        if (reply.ok) {
+            rec["response"] = reply.response();
+        } else {
+            rec["error"] = reply.error.empty() ? "sin respuesta" : reply.error;
         }
-        
-        // Mostrar respuesta
-        if (!response.empty()) {
-            std::cout << "✅ Respuesta:" << std::endl;
-            std::cout << response["response"] << std::endl;
-            std::cout << std::endl << "⏱️  Tiempo: " << duration.count() << "ms" << std::endl;
+        std::cout << dumpLine(rec);
+    } else if (!reply.ok) {
+        std::cerr << "❌ Error: " << (reply.error.empty() ? "No se pudo obtener respuesta" : reply.error) << std::endl;
+    } else if (outputMode == OutputMode::Quiet) {
+        std::cout << reply.response() << '\n';
+    } else {
+        std::cout << reply.response() << "\n\n"
+                  << "🧠 Turno " << session.turns << ": " << session.context.size() << " tokens de contexto, "
+                  << reply.promptEvalCount << " evaluados, " << ms << "ms\n";
+    }
+    if (!reply.ok) {
+        return false;
+    }
+    if (!saveSession(sessionPath(session.name), session)) {
+        std::cerr << "⚠️  No se pudo guardar la sesión en " << sessionPath(session.name) << std::endl;
+    }
+    return true;
+}
+
+// Señal de parada para los comandos que corren hasta Ctrl+C (mockserve, warm --every)
+volatile std::sig_atomic_t stopRequested = 0;
+
+void onStopSignal(int) {
+    stopRequested = 1;
+}
+
+void waitForStopSignal() {
+    std::signal(SIGINT, onStopSignal);
+    std::signal(SIGTERM, onStopSignal);
+    while (!stopRequested) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+}
+
+// Duración estilo Ollama ("90", "45s", "10m", "2h") en segundos; -1 si no es válida
+long parseDurationSeconds(const std::string& text) {
+    char* rest = nullptr;
+    long n = std::strtol(text.c_str(), &rest, 10);
+    if (rest == text.c_str() || n < 0) {
+        return -1;
+    }
+    std::string unit = rest;
+    if (unit.empty() || unit == "s") {
+        return n;
+    }
+    if (unit == "m") {
+        return n * 60;
+    }
+    if (unit == "h") {
+        return n * 3600;
+    }
+    return -1;
+}
+
+// Mostrar el resultado de precargar un modelo
+void printWarmResult(const std::string& model, const GenerateReply& r) {
+    if (!r.ok) {
+        std::cout << "❌ " << model << ": " << (r.error.empty() ? "sin respuesta" : r.error) << std::endl;
+        return;
+    }
+    std::cout << "🔥 " << model << ": carga " << r.loadDuration / 1000000 << "ms, total "
+              << r.totalDuration / 1000000 << "ms" << std::endl;
+}
+
+// Prompts de --prompts: una línea por prompt, en texto o como en batch (JSON string u objeto con "prompt")
+bool loadProfilePrompts(const std::string& path, std::vector<std::string>& prompts) {
+    std::ifstream in(path);
+    if (!in.is_open()) {
+        return false;
+    }
+    std::string line;
+    while (std::getline(in, line)) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (line.empty()) {
+            continue;
+        }
+        json item = json::parse(line, nullptr, false);
+        if (item.is_object() && item.contains("prompt") && item["prompt"].is_string()) {
+            prompts.push_back(item["prompt"].get<std::string>());
+        } else if (item.is_string()) {
+            prompts.push_back(item.get<std::string>());
+        } else {
+            prompts.push_back(line);
         }
-        
-        return response;
     }
-    
-    // Llamada asíncrona
-    std::future<json> askAsync(const std::string& question) {
-        std::cout << "🔄 Iniciando pregunta asíncrona..." << std::endl;
-        
-        return std::async(std::launch::async, [this, question]() {
-            json data = {
-                {"model", model},
-                {"prompt", question},
-                {"stream", false},
-                {"options", {
-                    {"temperature", 0.7},
-                    {"num_predict", 100},
-                    {"top_k", 40},
-                    {"top_p", 0.9},
-                    {"repeat_penalty", 1.1}
-                }}
-            };
-            
-            return makeRequest(data);
-        });
+    return true;
+}
+
+void printProfileCell(const std::string& model, const ProfileCell& c) {
+    if (outputMode == OutputMode::Json) {
+        std::cout << dumpLine({{"model", model}, {"num_predict", c.numPredict}, {"concurrency", c.concurrency},
+                               {"requests", c.requests}, {"errors", c.errors}, {"gen_tps", c.genTps},
+                               {"stream_tps", c.streamTps}, {"prompt_tps", c.promptTps}, {"p50_ms", c.p50Ms},
+                               {"p95_ms", c.p95Ms}, {"overhead_ms", c.overheadMs}, {"load_ms", c.loadMs}});
+        return;
     }
+    std::cout << std::fixed << std::setprecision(1)
+              << std::setw(9) << c.concurrency << std::setw(6) << c.requests
+              << std::setw(11) << c.genTps << std::setw(11) << c.streamTps
+              << std::setw(12) << (c.promptTps > 0 ? std::to_string(static_cast<long>(c.promptTps)) : "-")
+              << std::setw(10) << c.p50Ms << std::setw(10) << c.p95Ms
+              << std::setw(10) << c.overheadMs << std::setw(8) << c.errors << "\n";
+}
+
+// profile: por modelo, carga (en frío salvo --no-cold) y barrido num_predict x concurrencia sin
+// cache. Cada petición lleva un prefijo único para que Ollama no reutilice la caché KV del prompt
+// y prompt_eval mida el prompt entero. Devuelve 1 si algún modelo o petición falló.
+int runProfile(OllamaClient& client, const std::vector<std::string>& models, const std::vector<std::string>& prompts,
+               const std::vector<long>& levels, const std::vector<long>& predicts, size_t rounds, bool cold) {
+    client.setSchedulerSlots(0); // El límite de concurrencia lo pone el barrido, no el planificador
+    client.setHedging(false);    // Sin copias de respaldo: cada petición se mide una vez
+    bool failed = false;
+    std::atomic<unsigned long> seq{0};
     
-    // Pregunta rápida (menos tokens)
-    json askFast(const std::string& question, bool useCache = true) {
-        std::cout << "⚡ Pregunta rápida: " << question << std::endl << std::endl;
+    for (const auto& m : models) {
+        client.setModel(m);
+        if (cold) {
+            client.preload(m, "0"); // keep_alive 0: descargarlo para medir la carga desde disco
+        }
+        GenerateReply load = client.preload(m, DEFAULT_KEEP_ALIVE);
+        if (!load.ok) {
+            failed = true;
+            std::cerr << "❌ " << m << ": " << (load.error.empty() ? "sin respuesta" : load.error) << std::endl;
+            continue;
+        }
+        double loadMs = load.loadDuration / 1e6;
+        if (outputMode == OutputMode::Json) {
+            std::cout << dumpLine({{"model", m}, {"load_ms", loadMs}, {"cold", cold}});
+        } else {
+            std::cout << "📈 Perfil de " << m << "\n"
+                      << "   🔥 Carga: " << std::fixed << std::setprecision(0) << loadMs << "ms"
+                      << (cold ? " (en frío)" : "") << "\n";
+        }
         
-        // Verificar cache
-        if (useCache) {
-            std::string hash = generateHash(question, model);
-            auto it = ollamaCache.find(hash);
-            if (it != ollamaCache.end()) {
-                auto now = std::chrono::system_clock::now();
-                if (now < it->second.expiry) {
-                    std::cout << "⚡ Respuesta rápida desde cache:" << std::endl;
-                    std::cout << it->second.response["response"] << std::endl;
-                    std::cout << std::endl << "⚡ Cache hit - tiempo instantáneo" << std::endl;
-                    return it->second.response;
-                } else {
-                    ollamaCache.erase(it);
-                }
+        for (long numPredict : predicts) {
+            json options = ASK_OPTIONS;
+            options["num_predict"] = numPredict;
+            if (outputMode == OutputMode::Human) {
+                std::cout << "   num_predict " << numPredict << "\n"
+                          << "     conc   pet  gen tok/s  tok/s/flujo  prompt t/s   p50 ms   p95 ms  fuera ms errores\n";
+            }
+            std::vector<ProfileCell> cells;
+            for (long level : levels) {
+                size_t n = rounds * static_cast<size_t>(level);
+                std::vector<ProfileSample> samples(n);
+                auto start = std::chrono::steady_clock::now();
+                {
+                    ThreadPool workers(static_cast<size_t>(level), n);
+                    for (size_t i = 0; i < n; ++i) {
+                        workers.submit([&, i]() {
+                            std::string prompt = "#" + std::to_string(seq++) + " " + prompts[i % prompts.size()];
+                            auto t0 = std::chrono::steady_clock::now();
+                            QueryResult r = client.query(prompt, options, false, Priority::Batch);
+                            samples[i] = profileSample(r.reply, std::chrono::duration_cast<std::chrono::microseconds>(
+                                                                    std::chrono::steady_clock::now() - t0).count());
+                        });
+                    }
+                } // El pool espera a que terminen todas
+                long long wallUs = std::chrono::duration_cast<std::chrono::microseconds>(
+                    std::chrono::steady_clock::now() - start).count();
+                cells.push_back(summarizeCell(level, numPredict, samples, wallUs));
+                failed = failed || cells.back().errors > 0;
+                printProfileCell(m, cells.back());
+            }
+            
+            bool saturated = false;
+            const ProfileCell& knee = cells[throughputKnee(cells, saturated)];
+            if (outputMode == OutputMode::Json) {
+                std::cout << dumpLine({{"model", m}, {"num_predict", numPredict}, {"knee_concurrency", knee.concurrency},
+                                       {"knee_gen_tps", knee.genTps}, {"saturated", saturated}});
+            } else if (saturated) {
+                std::cout << "   📍 Codo: concurrencia " << knee.concurrency << " (" << std::setprecision(1)
+                          << knee.genTps << " tok/s); más allá solo crece la latencia -> OLLAMA_NUM_PARALLEL="
+                          << knee.concurrency << "\n";
+            } else {
+                std::cout << "   📍 Sin codo hasta concurrencia " << knee.concurrency
+                          << ": el servidor aún escala, probar niveles mayores\n";
             }
         }
-        
-        // Preparar datos para pregunta rápida
-        json data = {
-            {"model", model},
-            {"prompt", question},
-            {"stream", false},
-            {"options", {
-                {"temperature", 0.1},
-                {"num_predict", 20},
-                {"top_k", 10},
-                {"top_p", 0.9},
-                {"repeat_penalty", 1.1}
-            }}
-        };
-        
-        auto start = std::chrono::high_resolution_clock::now();
-        
-        json response = makeRequest(data);
-        
-        auto end = std::chrono::high_resolution_clock::now();
-        auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
-        
-        // Guardar en cache
-        if (useCache && !response.empty()) {
-            std::string hash = generateHash(question, model);
-            CacheEntry entry;
-            entry.response = response;
-            entry.expiry = std::chrono::system_clock::now() + std::chrono::seconds(CACHE_EXPIRY);
-            ollamaCache[hash] = entry;
+    }
+    std::cout.flush();
+    return failed ? 1 : 0;
+}
+
+// Servir el mock hasta Ctrl+C; imprime las peticiones atendidas al salir
+int runMockServer(const MockConfig& config, int port) {
+    MockServer mock(config);
+    if (!mock.start(port)) {
+        std::cerr << "❌ Error: No se pudo escuchar en el puerto " << port
+                  << " (¿Ollama ya está en marcha? usa --port)" << std::endl;
+        return 1;
+    }
+
+    std::cout << "🧪 Servidor mock en " << mock.url() << std::endl;
+    std::cout << "   Latencia: " << config.latencyMs << "ms, ritmo: ";
+    if (config.tokensPerSec > 0) {
+        std::cout << config.tokensPerSec << " tokens/s";
+    } else {
+        std::cout << "sin límite";
+    }
+    std::cout << (config.stream ? ", streaming forzado" : "") << std::endl;
+    std::cout << "   Ctrl+C para detener" << std::endl;
+
+    waitForStopSignal();
+    mock.stop();
+    std::cout << std::endl << "🛑 Mock detenido: " << mock.requestsServed() << " peticiones atendidas" << std::endl;
+    return 0;
+}
+
+// Comando serve: un OllamaClient residente atendiendo ask/fast/cachestats/metrics por IPC
+int runDaemon(OllamaClient& client, const std::string& path) {
+    DaemonServer daemon(client);
+    if (!daemon.start(path)) {
+        std::cerr << "❌ Error: No se pudo escuchar en " << path
+                  << " (¿ya hay un daemon en marcha? usa --socket)" << std::endl;
+        return 1;
+    }
+    // Abrir el cache ya: la primera petición no paga el mapeo del archivo
+    size_t entries = client.cacheStats().total;
+
+    std::cout << "🛰️  Daemon en " << daemon.socketPath() << std::endl;
+    std::cout << "   Modelo: " << client.getModel() << ", cache: " << entries << " elementos" << std::endl;
+    if (client.getSemanticThreshold() > 0) {
+        std::cout << "   Tier semántico: similitud >= " << client.getSemanticThreshold()
+                  << " con " << defaultEmbedModel() << std::endl;
+    }
+    std::cout << "   ask, fast, batch y cachestats se reenvían aquí (--local para no usarlo)" << std::endl;
+    std::cout << "   Ctrl+C para detener" << std::endl << std::flush;
+
+    waitForStopSignal();
+    daemon.stop();
+    std::cout << std::endl << "🛑 Daemon detenido: " << daemon.requestsServed() << " peticiones atendidas" << std::endl;
+    return 0;
+}
+
+// ask/fast/cachestats a través del daemon. 'next' queda en la primera pregunta que no llegó
+// a responder (argc si respondió todas); false si el resto hay que hacerlo en local.
+bool runForwarded(DaemonClient& daemon, int argc, char* argv[], int& failures, int& next) {
+    std::string command = argv[1];
+    next = 2;
+    if (command == "cachestats") {
+        CacheStats st;
+        if (!daemon.cacheStats(st)) {
+            return false;
         }
-        
-        if (!response.empty()) {
-            std::cout << "✅ Respuesta rápida:" << std::endl;
-            std::cout << response["response"] << std::endl;
-            std::cout << std::endl << "⚡ Tiempo: " << duration.count() << "ms" << std::endl;
+        printCacheStats(st);
+        return true;
+    }
+    bool fast = command == "fast";
+    for (; next < argc; ++next) {
+        std::string question = argv[next];
+        printQuestion(question, fast);
+        QueryResult r;
+        if (!daemon.query(question, fast, DEFAULT_MODEL, r)) {
+            return false;
         }
-        
-        return response;
+        printResult(question, r, fast);
+        failures += r.reply.ok ? 0 : 1;
+    }
+    return true;
+}
+
+const size_t EMBED_CHUNK_CHARS = 2000;
+
+// Añadir un archivo, directorio o glob (en trozos por líneas) o, si no existe, el texto literal
+void collectEmbedInputs(const std::string& arg, size_t chunkChars,
+                        std::vector<std::string>& inputs, std::vector<std::string>& labels, size_t& files) {
+    std::error_code ec;
+    if (arg.find_first_of("*?") == std::string::npos && !std::filesystem::exists(arg, ec)) {
+        labels.push_back("texto");
+        inputs.push_back(arg);
+        return;
+    }
+    ContextFiles context;
+    loadContext(arg, chunkChars, context);
+    for (auto& chunk : context.chunks) {
+        labels.push_back(chunk.origin + ":" + std::to_string(chunk.line));
+        inputs.push_back(std::move(chunk.text));
+    }
+    files += context.files;
+}
+
+// Prompt de ask/fast --context: los trozos que caben en la ventana (num_ctx menos la respuesta
+// y la pregunta). Si no caben todos, van los más parecidos a la pregunta; sus embeddings se
+// guardan por contenido, así que un árbol sin cambios no los vuelve a pedir.
+bool contextPrompt(OllamaClient& client, const ContextFiles& context, const std::string& question,
+                   const json& options, std::string& prompt) {
+    size_t numCtx = static_cast<size_t>(options.value("num_ctx", DEFAULT_NUM_CTX));
+    size_t fixed = estimateTokens(question.size() + 64) + static_cast<size_t>(predictedTokens(options)) +
+                   CONTEXT_RESERVE_TOKENS;
+    if (fixed >= numCtx) {
+        std::cerr << "❌ Error: la ventana de contexto (num_ctx " << numCtx << ") no deja sitio para archivos"
+                  << std::endl;
+        return false;
+    }
+    size_t budget = numCtx - fixed;
+    size_t total = 0;
+    for (const auto& chunk : context.chunks) {
+        total += chunk.tokens;
     }
     
-    // Cambiar modelo
-    void setModel(const std::string& newModel) {
-        model = newModel;
-        std::cout << "🤖 Modelo cambiado a: " << model << std::endl;
+    std::vector<float> scores;
+    if (total > budget) {
+        std::vector<std::string> inputs;
+        inputs.reserve(context.chunks.size() + 1);
+        inputs.push_back(question);
+        for (const auto& chunk : context.chunks) {
+            inputs.push_back(chunk.text);
+        }
+        Embeddings e = client.embed(inputs);
+        if (e.ok) {
+            const float* q = e.row(0);
+            float qNorm = std::sqrt(dotProduct(q, q, e.dim));
+            scores.resize(context.chunks.size());
+            for (size_t i = 0; i < scores.size(); ++i) {
+                const float* v = e.row(i + 1);
+                float norm = qNorm * std::sqrt(dotProduct(v, v, e.dim));
+                scores[i] = norm > 0 ? dotProduct(q, v, e.dim) / norm : 0.0f;
+            }
+        } else if (outputMode == OutputMode::Human) {
+            std::cerr << "⚠️  Sin embeddings (" << e.error << "): los trozos entran en orden" << std::endl;
+        }
     }
+    std::vector<size_t> selected = selectContext(context.chunks, budget, scores.empty() ? nullptr : &scores);
+    prompt = composeContextPrompt(context.chunks, selected, question);
     
-    // Mostrar estado
-    void status() {
-        std::cout << "🤖 Estado de Ollama:" << std::endl;
-        std::cout << "   Modelo: " << model << std::endl;
-        std::cout << "   Endpoint: " << endpoint << std::endl;
-        std::cout << "   Cache: " << ollamaCache.size() << " elementos" << std::endl;
-        
-        // Verificar conexión
-        json data = {{"model", model}};
-        json response = makeRequest(data, "/api/tags");
-        
-        if (!response.empty()) {
-            std::cout << "   ✅ Servidor conectado" << std::endl;
-        } else {
-            std::cout << "   ❌ Servidor no disponible" << std::endl;
+    if (outputMode == OutputMode::Human) {
+        size_t used = 0;
+        for (size_t i : selected) {
+            used += context.chunks[i].tokens;
         }
+        std::cerr << "📎 Contexto: " << selected.size() << " de " << context.chunks.size() << " trozos, ~"
+                  << used << " de " << budget << " tokens" << (scores.empty() ? "" : " (por similitud)") << std::endl;
+    }
+    return true;
+}
+
+// Comando embed: vectores de textos/archivos, resumen por consola y opcionalmente un archivo binario
+int runEmbed(OllamaClient& client, const std::vector<std::string>& args, const std::string& embedModel,
+             const std::string& outPath, size_t chunkChars) {
+    std::vector<std::string> inputs;
+    std::vector<std::string> labels;
+    size_t files = 0;
+    for (const auto& arg : args) {
+        collectEmbedInputs(arg, chunkChars, inputs, labels, files);
+    }
+    if (inputs.empty()) {
+        std::cerr << "❌ Error: nada que procesar" << std::endl;
+        return 1;
     }
     
-    // Limpiar cache
-    void clearCache() {
-        ollamaCache.clear();
-        std::cout << "🗑️  Cache limpiado" << std::endl;
+    auto start = std::chrono::steady_clock::now();
+    Embeddings e = client.embed(inputs, embedModel);
+    long long ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    if (!e.ok) {
+        std::cerr << "❌ Error de embeddings: " << e.error << std::endl;
+        return 1;
     }
     
-    // Estadísticas de cache
-    void cacheStats() {
-        int total = ollamaCache.size();
-        int valid = 0;
-        int expired = 0;
-        
-        auto now = std::chrono::system_clock::now();
-        for (const auto& entry : ollamaCache) {
-            if (now < entry.second.expiry) {
-                valid++;
-            } else {
-                expired++;
+    if (!outPath.empty()) {
+        // Filas en binario + una etiqueta (archivo:línea) por fila en <out>.txt
+        std::ofstream index(outPath + ".txt");
+        if (!saveEmbeddings(outPath, e) || !index.is_open()) {
+            std::cerr << "❌ Error: No se pudo crear " << outPath << std::endl;
+            return 1;
+        }
+        for (const auto& label : labels) {
+            index << label << '\n';
+        }
+    } else if (e.count <= 20) {
+        for (size_t i = 0; i < e.count; ++i) {
+            std::cout << labels[i] << " [";
+            for (size_t d = 0; d < std::min<size_t>(e.dim, 4); ++d) {
+                std::cout << (d > 0 ? ", " : "") << e.row(i)[d];
             }
+            std::cout << (e.dim > 4 ? ", ...]" : "]") << std::endl;
         }
-        
-        std::cout << "📊 Estadísticas de Cache:" << std::endl;
-        std::cout << "   Total: " << total << " elementos" << std::endl;
-        std::cout << "   Válidos: " << valid << std::endl;
-        std::cout << "   Expirados: " << expired << std::endl;
     }
+    std::cerr << "🧮 Embeddings: " << e.count << " entradas";
+    if (files > 0) {
+        std::cerr << " (" << files << " archivos)";
+    }
+    std::cerr << ", " << e.cached << " desde cache, dim " << e.dim << ", " << ms << "ms" << std::endl;
+    return 0;
+}
+
+// Función principal
+// Ejecutar un comando; argv[1] es el nombre del comando
+int runCommand(OllamaClient& client, int argc, char* argv[]) {
+    std::string command = argv[1];
     
-private:
-    json makeRequest(const json& data, const std::string& path = "/api/generate") {
-        CURL* curl = curl_easy_init();
-        if (!curl) {
-            std::cerr << "❌ Error: No se pudo inicializar CURL" << std::endl;
-            return json();
+    if ((command == "ask" || command == "fast") && argc > 2) {
+        // Varias preguntas: una línea de resultado por pregunta
+        bool fast = command == "fast";
+        std::vector<std::string> questions;
+        std::vector<std::string> contextSpecs;
+        int numCtx = defaultNumCtx();
+        for (int i = 2; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (arg == "--context" && i + 1 < argc) {
+                contextSpecs.push_back(argv[++i]);
+            } else if (arg == "--num-ctx" && i + 1 < argc) {
+                long n = std::strtol(argv[++i], nullptr, 10);
+                if (n > 0) {
+                    numCtx = static_cast<int>(n);
+                }
+            } else {
+                questions.push_back(arg);
+            }
         }
+        json options = fast ? FAST_OPTIONS : ASK_OPTIONS;
+        ContextFiles context;
+        if (!contextSpecs.empty()) {
+            // Los archivos se leen una vez para todas las preguntas
+            auto start = std::chrono::steady_clock::now();
+            for (const auto& spec : contextSpecs) {
+                loadContext(spec, CONTEXT_CHUNK_TOKENS * CONTEXT_BYTES_PER_TOKEN, context);
+            }
+            if (context.chunks.empty()) {
+                std::cerr << "❌ Error: ningún archivo de texto en el contexto" << std::endl;
+                return 1;
+            }
+            if (outputMode == OutputMode::Human) {
+                std::cerr << "📂 " << context.files << " archivos (" << context.bytes / 1024 << " KB) en "
+                          << std::chrono::duration_cast<std::chrono::milliseconds>(
+                                 std::chrono::steady_clock::now() - start).count() << "ms";
+                if (context.binary + context.large + context.ignored > 0) {
+                    std::cerr << "; omitidos: " << context.binary << " binarios, " << context.large
+                              << " grandes, " << context.ignored << " ignorados";
+                }
+                std::cerr << std::endl;
+            }
+            options["num_ctx"] = numCtx; // La ventana con la que se calculó el presupuesto
+        }
+        int failures = 0;
+        for (const auto& question : questions) {
+            printQuestion(question, fast);
+            std::string prompt = question;
+            if (!contextSpecs.empty() && !contextPrompt(client, context, question, options, prompt)) {
+                failures++;
+                continue;
+            }
+            QueryResult r = client.query(prompt, options);
+            printResult(question, r, fast);
+            failures += r.reply.ok ? 0 : 1;
+        }
+        return failures > 0 ? 1 : 0;
+    } else if (command == "stream" && argc > 2) {
+        std::string question = argv[2];
+        printQuestion(question, false);
         
-        std::string url = endpoint + path;
-        std::string jsonStr = data.dump();
-        std::string response;
+        auto start = std::chrono::high_resolution_clock::now();
+        long long ttft = -1;
+        std::string text; // Solo en --json: la línea se escribe al final
+        GenerateReply final = client.askStream(question, [&](const std::string& token) {
+            if (ttft < 0) {
+                ttft = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    std::chrono::high_resolution_clock::now() - start).count();
+            }
+            if (outputMode == OutputMode::Json) {
+                text += token;
+            } else {
+                std::cout << token << std::flush;
+            }
+        });
         
-        curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
-        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, jsonStr.c_str());
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
-        curl_easy_setopt(curl, CURLOPT_TIMEOUT, timeout);
+        double tps = final.evalCount > 0 && final.evalDuration > 0 ? final.evalCount * 1e9 / final.evalDuration : 0;
+        if (outputMode == OutputMode::Json) {
+            json rec = {{"prompt", question}, {"ttft_ms", ttft}, {"eval_count", final.evalCount},
+                        {"tokens_per_sec", tps}};
+            if (final.ok) {
+                rec["response"] = text;
+            } else {
+                rec["error"] = final.error.empty() ? "sin respuesta" : final.error;
+            }
+            std::cout << dumpLine(rec);
+            return final.ok ? 0 : 1;
+        }
+        std::cout << '\n';
+        if (!final.ok) {
+            std::cerr << "❌ Error: " << (final.error.empty() ? "sin respuesta" : final.error) << std::endl;
+            return 1;
+        }
+        if (outputMode == OutputMode::Quiet) {
+            return 0;
+        }
+        std::cout << "\n⏱️  Primer token: " << ttft << "ms\n";
+        if (tps > 0) {
+            std::cout << "⚡ " << final.evalCount << " tokens, "
+                      << std::fixed << std::setprecision(1) << tps << " tokens/s\n";
+        }
+    } else if (command == "batch" && argc > 2) {
+        std::string outPath;
+        size_t concurrency = defaultParallelism();
+        for (int i = 3; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (arg == "--concurrency" && i + 1 < argc) {
+                long n = std::strtol(argv[++i], nullptr, 10);
+                if (n > 0) {
+                    concurrency = static_cast<size_t>(n);
+                }
+            } else if (arg == "--out" && i + 1 < argc) {
+                outPath = argv[++i];
+            }
+        }
+        return runBatch(client, argv[2], outPath, concurrency);
+    } else if (command == "session" && argc > 2) {
+        Session session;
+        session.name = argv[2];
+        std::string question;
+        std::string keepAlive;
+        bool reset = false;
+        for (int i = 3; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (arg == "--keep-alive" && i + 1 < argc) {
+                keepAlive = argv[++i];
+            } else if (arg == "--reset") {
+                reset = true;
+            } else {
+                question = arg;
+            }
+        }
         
-        struct curl_slist* headers = NULL;
-        headers = curl_slist_append(headers, "Content-Type: application/json");
-        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+        std::string path = sessionPath(session.name);
+        if (reset) {
+            std::remove(path.c_str());
+            if (outputMode == OutputMode::Human) {
+                std::cout << "🗑️  Sesión '" << session.name << "' reiniciada\n";
+            }
+            if (question.empty()) {
+                return 0;
+            }
+        }
+        if (loadSession(path, session) && outputMode == OutputMode::Human) {
+            std::cout << "🧠 Sesión '" << session.name << "' (" << session.model << "): "
+                      << session.turns << " turnos, " << session.context.size() << " tokens de contexto\n";
+        }
+        if (!keepAlive.empty()) {
+            session.keepAlive = keepAlive;
+        }
         
-        CURLcode res = curl_easy_perform(curl);
+        if (!question.empty()) {
+            return runSessionTurn(client, session, question) ? 0 : 1;
+        }
         
-        curl_slist_free_all(headers);
-        curl_easy_cleanup(curl);
+        // Modo interactivo: una pregunta por línea hasta EOF o "salir"
+        std::string line;
+        while (std::cout << "💬 > " << std::flush, std::getline(std::cin, line)) {
+            if (line == "salir" || line == "exit") {
+                break;
+            }
+            if (!line.empty()) {
+                runSessionTurn(client, session, line);
+            }
+        }
+    } else if (command == "warm") {
+        std::vector<std::string> models;
+        std::string keepAlive = DEFAULT_KEEP_ALIVE;
+        long every = 0;
+        for (int i = 2; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (arg == "--keep-alive" && i + 1 < argc) {
+                keepAlive = argv[++i];
+            } else if (arg == "--every" && i + 1 < argc) {
+                every = parseDurationSeconds(argv[++i]);
+                if (every <= 0) {
+                    std::cerr << "❌ Error: intervalo no válido: " << argv[i] << std::endl;
+                    return 1;
+                }
+            } else {
+                models.push_back(arg);
+            }
+        }
+        if (models.empty()) {
+            models.push_back(DEFAULT_MODEL);
+        }
         
-        if (res != CURLE_OK) {
-            std::cerr << "❌ Error CURL: " << curl_easy_strerror(res) << std::endl;
-            return json();
+        if (every == 0) {
+            bool allOk = true;
+            for (const auto& m : models) {
+                GenerateReply r = client.preload(m, keepAlive);
+                printWarmResult(m, r);
+                allOk = allOk && r.ok;
+            }
+            return allOk ? 0 : 1;
         }
         
-        try {
-            return json::parse(response);
-        } catch (const std::exception& e) {
-            std::cerr << "❌ Error parsing JSON: " << e.what() << std::endl;
-            return json();
+        std::cout << "⏰ Precargando " << models.size() << " modelo(s) cada " << every
+                  << "s con keep_alive " << keepAlive << " (Ctrl+C para detener)" << std::endl;
+        client.keepWarm(models, keepAlive, every, printWarmResult);
+        waitForStopSignal();
+        client.stopKeepWarm();
+    } else if (command == "profile") {
+        std::vector<std::string> models;
+        std::vector<std::string> prompts;
+        std::vector<long> levels, predicts;
+        parseCountList(PROFILE_DEFAULT_CONCURRENCY, levels);
+        parseCountList(PROFILE_DEFAULT_NUM_PREDICT, predicts);
+        size_t rounds = PROFILE_DEFAULT_ROUNDS;
+        bool cold = true;
+        for (int i = 2; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (arg == "--prompts" && i + 1 < argc) {
+                if (!loadProfilePrompts(argv[++i], prompts)) {
+                    std::cerr << "❌ Error: No se pudo abrir " << argv[i] << std::endl;
+                    return 1;
+                }
+            } else if (arg == "--concurrency" && i + 1 < argc) {
+                if (!parseCountList(argv[++i], levels)) {
+                    std::cerr << "❌ Error: lista de concurrencia no válida: " << argv[i] << std::endl;
+                    return 1;
+                }
+            } else if (arg == "--num-predict" && i + 1 < argc) {
+                if (!parseCountList(argv[++i], predicts)) {
+                    std::cerr << "❌ Error: lista de num_predict no válida: " << argv[i] << std::endl;
+                    return 1;
+                }
+            } else if (arg == "--rounds" && i + 1 < argc) {
+                long n = std::strtol(argv[++i], nullptr, 10);
+                if (n > 0) {
+                    rounds = static_cast<size_t>(n);
+                }
+            } else if (arg == "--no-cold") {
+                cold = false;
+            } else {
+                models.push_back(arg);
+            }
+        }
+        if (models.empty()) {
+            models.push_back(client.getModel());
+        }
+        if (prompts.empty()) {
+            prompts.push_back(PROFILE_DEFAULT_PROMPT);
+        }
+        return runProfile(client, models, prompts, levels, predicts, rounds, cold);
+    } else if (command == "mockserve") {
+        MockConfig config;
+        int port = 11434;
+        for (int i = 2; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (arg == "--port" && i + 1 < argc) {
+                port = std::atoi(argv[++i]);
+            } else if (arg == "--latency-ms" && i + 1 < argc) {
+                config.latencyMs = std::strtol(argv[++i], nullptr, 10);
+            } else if (arg == "--tokens-per-sec" && i + 1 < argc) {
+                config.tokensPerSec = std::strtol(argv[++i], nullptr, 10);
+            } else if (arg == "--tokens" && i + 1 < argc) {
+                config.tokens = std::strtol(argv[++i], nullptr, 10);
+            } else if (arg == "--parallel" && i + 1 < argc) {
+                config.parallel = std::strtol(argv[++i], nullptr, 10);
+            } else if (arg == "--slow-every" && i + 1 < argc) {
+                config.slowEvery = std::strtol(argv[++i], nullptr, 10);
+            } else if (arg == "--slow-ms" && i + 1 < argc) {
+                config.slowMs = std::strtol(argv[++i], nullptr, 10);
+            } else if (arg == "--stream") {
+                config.stream = true;
+            } else if (arg == "--loaded" && i + 1 < argc) {
+                // Modelos que /api/ps anuncia como cargados, separados por comas
+                config.loadedModels.clear();
+                std::stringstream list(argv[++i]);
+                std::string m;
+                while (std::getline(list, m, ',')) {
+                    if (!m.empty()) {
+                        config.loadedModels.push_back(m);
+                    }
+                }
+            } else if (arg == "--response-file" && i + 1 < argc) {
+                std::ifstream f(argv[++i], std::ios::binary);
+                if (!f.is_open()) {
+                    std::cerr << "❌ Error: No se pudo abrir " << argv[i] << std::endl;
+                    return 1;
+                }
+                std::stringstream ss;
+                ss << f.rdbuf();
+                config.cannedResponse = ss.str();
+            }
         }
+        return runMockServer(config, port);
+    } else if (command == "serve") {
+        std::string path = defaultIpcPath();
+        for (int i = 2; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (arg == "--socket" && i + 1 < argc) {
+                path = argv[++i];
+            }
+        }
+        return runDaemon(client, path);
+    } else if (command == "embed" && argc > 2) {
+        std::vector<std::string> args;
+        std::string embedModel = defaultEmbedModel();
+        std::string outPath;
+        size_t chunkChars = EMBED_CHUNK_CHARS;
+        for (int i = 2; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (arg == "--model" && i + 1 < argc) {
+                embedModel = argv[++i];
+            } else if (arg == "--out" && i + 1 < argc) {
+                outPath = argv[++i];
+            } else if (arg == "--chunk" && i + 1 < argc) {
+                long n = std::strtol(argv[++i], nullptr, 10);
+                if (n > 0) {
+                    chunkChars = static_cast<size_t>(n);
+                }
+            } else {
+                args.push_back(arg);
+            }
+        }
+        return runEmbed(client, args, embedModel, outPath, chunkChars);
+    } else if (command == "status") {
+        client.status();
+    } else if (command == "clearcache") {
+        client.clearCache();
+        if (outputMode == OutputMode::Human) {
+            std::cout << "🗑️  Cache limpiado\n";
+        }
+    } else if (command == "cachestats") {
+        printCacheStats(client.cacheStats());
+    } else {
+        std::cout << "❌ Comando no válido" << std::endl;
+        return 1;
     }
-};
-
+    
+    return 0;
+} 
 // Función principal
 int main(int argc, char* argv[]) {
+    // --quiet / --json valen en cualquier posición; el resto de argumentos sigue igual
+    std::vector<char*> filtered;
+    for (int i = 0; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (i > 0 && arg == "--local") {
+            daemonForwarding = false;
+        } else if (i > 0 && (arg == "--quiet" || arg == "-q")) {
+            outputMode = OutputMode::Quiet;
+        } else if (i > 0 && arg == "--json") {
+            outputMode = OutputMode::Json;
+        } else {
+            filtered.push_back(argv[i]);
+        }
+    }
+    argc = static_cast<int>(filtered.size());
+    argv = filtered.data();
+    // Salida con buffer: sin sincronizar con stdio, cout no se vacía en cada línea
+    std::ios::sync_with_stdio(false);
+    
     if (argc < 2) {
         std::cout << "🚀 Ollama C++ Client" << std::endl;
         std::cout << "Uso: " << argv[0] << " <comando> [argumentos]" << std::endl;
+        std::cout << "Opciones: --quiet (solo el texto), --json (una línea JSON por resultado)," << std::endl;
+        std::cout << "          --local (no reenviar al daemon de serve)" << std::endl;
         std::cout << "Comandos:" << std::endl;
-        std::cout << "  ask <pregunta>     - Pregunta normal" << std::endl;
-        std::cout << "  fast <pregunta>    - Pregunta rápida" << std::endl;
+        std::cout << "  ask <pregunta...>  - Pregunta normal" << std::endl;
+        std::cout << "  fast <pregunta...> - Pregunta rápida" << std::endl;
+        std::cout << "      [--context dir|archivo|glob] [--num-ctx N]" << std::endl;
+        std::cout << "                     - Con archivos del proyecto como contexto (ajustado a la ventana)" << std::endl;
+        std::cout << "  stream <pregunta>  - Pregunta en streaming (token a token)" << std::endl;
+        std::cout << "  batch <prompts.jsonl> [--concurrency N] [--out results.jsonl]" << std::endl;
+        std::cout << "                     - Ejecutar prompts en paralelo (salida JSONL)" << std::endl;
+        std::cout << "  session <nombre> [pregunta] [--keep-alive 30m] [--reset]" << std::endl;
+        std::cout << "                     - Conversación multi-turno (sin pregunta: modo interactivo)" << std::endl;
+        std::cout << "  warm [modelo...] [--keep-alive 30m] [--every 10m]" << std::endl;
+        std::cout << "                     - Precargar modelos (opcionalmente cada cierto tiempo)" << std::endl;
+        std::cout << "  profile [modelo...] [--prompts archivo] [--concurrency 1,2,4,8] [--num-predict 32,128]" << std::endl;
+        std::cout << "          [--rounds N] [--no-cold]" << std::endl;
+        std::cout << "                     - Tokens/s de prompt y generación, carga y codo de concurrencia" << std::endl;
+        std::cout << "  mockserve [--port N] [--latency-ms N] [--tokens-per-sec N] [--tokens N]" << std::endl;
+        std::cout << "            [--stream] [--response-file f]" << std::endl;
+        std::cout << "            [--parallel N] [--loaded m1,m2] [--slow-every N --slow-ms N]" << std::endl;
+        std::cout << "                     - Servidor Ollama simulado para pruebas de carga" << std::endl;
+        std::cout << "  embed <texto|archivo|dir|glob...> [--model m] [--out vectores.bin] [--chunk N]" << std::endl;
+        std::cout << "                     - Embeddings por lotes (/api/embed) con cache de vectores" << std::endl;
+        std::cout << "  serve [--socket ruta]" << std::endl;
+        std::cout << "                     - Daemon residente: ask/fast/batch/cachestats se le reenvían por IPC" << std::endl;
+        std::cout << "  metrics [--prom] [--out f] [comando] [argumentos]" << std::endl;
+        std::cout << "                     - Ejecutar un comando y volcar histogramas por fase (JSON/Prometheus);" << std::endl;
+        std::cout << "                       sin comando, los del daemon" << std::endl;
         std::cout << "  status             - Estado del servidor" << std::endl;
         std::cout << "  clearcache         - Limpiar cache" << std::endl;
         std::cout << "  cachestats         - Estadísticas de cache" << std::endl;
         return 1;
     }
     
+    // Con un daemon (serve) escuchando, ask/fast/cachestats van por IPC: ni cache ni libcurl aquí
+    std::string command = argv[1];
+    std::vector<char*> rest;
+    int forwardedFailures = 0;
+    // --context se resuelve aquí: los archivos son los de este directorio
+    bool withContext = std::any_of(argv + 1, argv + argc, [](const char* a) {
+        return std::strcmp(a, "--context") == 0 || std::strcmp(a, "--num-ctx") == 0;
+    });
+    if (daemonForwarding && !withContext &&
+        (((command == "ask" || command == "fast") && argc > 2) || command == "cachestats")) {
+        DaemonClient daemon;
+        int next = argc;
+        if (daemon.connect()) {
+            if (runForwarded(daemon, argc, argv, forwardedFailures, next)) {
+                return forwardedFailures > 0 ? 1 : 0;
+            }
+            // El daemon se cayó a mitad: las preguntas que faltan se hacen en local
+            rest.assign(argv, argv + 2);
+            rest.insert(rest.end(), argv + next, argv + argc);
+            argc = static_cast<int>(rest.size());
+            argv = rest.data();
+        }
+    }
+    
     OllamaClient client;
     
-    std::string command = argv[1];
+    if (command != "metrics") {
+        int code = runCommand(client, argc, argv);
+        return forwardedFailures > 0 ? 1 : code;
+    }
     
-    if (command == "ask" && argc > 2) {
-        std::string question = argv[2];
-        client.ask(question);
-    } else if (command == "fast" && argc > 2) {
-        std::string question = argv[2];
-        client.askFast(question);
-    } else if (command == "status") {
-        client.status();
-    } else if (command == "clearcache") {
-        client.clearCache();
-    } else if (command == "cachestats") {
-        client.cacheStats();
+    // metrics: el resto de argumentos es el comando a medir
+    bool prometheus = false;
+    std::string metricsPath;
+    int first = 2;
+    while (first < argc) {
+        std::string arg = argv[first];
+        if (arg == "--prom") {
+            prometheus = true;
+            first++;
+        } else if (arg == "--out" && first + 1 < argc) {
+            metricsPath = argv[first + 1];
+            first += 2;
+        } else {
+            break;
+        }
+    }
+    std::string dump;
+    int code = 0;
+    if (first >= argc) {
+        // Sin comando: los histogramas acumulados por el daemon
+        DaemonClient daemon;
+        if (!daemonForwarding || !daemon.connect() || !daemon.metricsDump(prometheus, dump)) {
+            std::cerr << "❌ Error: metrics necesita un comando (p. ej. metrics batch prompts.jsonl) "
+                      << "o un daemon en marcha (serve)" << std::endl;
+            return 1;
+        }
     } else {
-        std::cout << "❌ Comando no válido" << std::endl;
-        return 1;
+        std::vector<char*> args;
+        args.push_back(argv[0]);
+        args.insert(args.end(), argv + first, argv + argc);
+        code = runCommand(client, static_cast<int>(args.size()), args.data());
+        MetricsSnapshot snapshot = metrics().snapshot();
+        dump = prometheus ? metricsPrometheus(snapshot) : metricsJson(snapshot) + "\n";
     }
-    
-    return 0;
-} 
\ No newline at end of file
+    if (metricsPath.empty()) {
+        std::cerr << dump;
+    } else {
+        std::ofstream out(metricsPath, std::ios::binary | std::ios::trunc);
+        if (!out.is_open() || !(out << dump)) {
+            std::cerr << "❌ Error: No se pudo crear " << metricsPath << std::endl;
+            return 1;
+        }
+    }
+    return code;
+}
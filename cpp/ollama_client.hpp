@@ -0,0 +1,852 @@
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <map>
+#include <unordered_map>
+#include <chrono>
+#include <thread>
+#include <future>
+#include <memory>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+#include <curl/curl.h>
+#include <nlohmann/json.hpp>
+#include "ollama_balancer.hpp"
+#include "ollama_cache.hpp"
+#include "ollama_embed.hpp"
+#include "ollama_http.hpp"
+#include "ollama_latency.hpp"
+#include "ollama_metrics.hpp"
+#include "ollama_pool.hpp"
+#include "ollama_reply.hpp"
+#include "ollama_request.hpp"
+#include "ollama_scheduler.hpp"
+#include "ollama_semantic.hpp"
+#include "ollama_session.hpp"
+
+using json = nlohmann::json;
+
+// Configuración por defecto
+const std::string DEFAULT_MODEL = "codellama:7b-code-q4_K_M";
+const std::string DEFAULT_ENDPOINT = "http://localhost:11434";
+const int DEFAULT_TIMEOUT = 30;
+const int CACHE_EXPIRY = 3600; // 1 hora
+const int MAX_CACHE_SIZE = 1000; // Máximo elementos en cache
+const int DEFAULT_NUM_PREDICT = 128; // El de Ollama cuando 'options' no trae num_predict
+const size_t REQUEST_TEMPLATE_CACHE = 8; // Plantillas de cuerpo por hilo (modelo, opciones, stream)
+
+// Opciones de muestreo por modo
+const json ASK_OPTIONS = {
+    {"temperature", 0.7},
+    {"num_predict", 100},
+    {"top_k", 40},
+    {"top_p", 0.9},
+    {"repeat_penalty", 1.1}
+};
+const json FAST_OPTIONS = {
+    {"temperature", 0.1},
+    {"num_predict", 20},
+    {"top_k", 10},
+    {"top_p", 0.9},
+    {"repeat_penalty", 1.1}
+};
+
+// Endpoint(s) del servidor (OLLAMA_ENDPOINT si está definido; varios separados por comas)
+inline std::string defaultEndpoint() {
+    const char* env = std::getenv("OLLAMA_ENDPOINT");
+    if (env && *env) {
+        return env;
+    }
+    return DEFAULT_ENDPOINT;
+}
+
+// Afinidad de modelo activada con OLLAMA_AFFINITY=1
+inline bool defaultAffinity() {
+    const char* env = std::getenv("OLLAMA_AFFINITY");
+    return env && *env && std::string(env) != "0";
+}
+
+// Huecos del planificador: OLLAMA_SCHEDULER_SLOTS si está definido (0 = sin planificador),
+// si no, las peticiones que atiende cada nodo a la vez por el número de nodos
+inline size_t defaultSchedulerSlots(size_t parallel, size_t nodes) {
+    const char* env = std::getenv("OLLAMA_SCHEDULER_SLOTS");
+    if (env && *env) {
+        long n = std::strtol(env, nullptr, 10);
+        return n > 0 ? static_cast<size_t>(n) : 0;
+    }
+    return parallel * std::max<size_t>(nodes, 1);
+}
+
+// Tokens a generar según 'options' (para estimar la duración de la petición)
+inline int predictedTokens(const json& options) {
+    auto it = options.find("num_predict");
+    if (it == options.end() || !it->is_number_integer()) {
+        return DEFAULT_NUM_PREDICT;
+    }
+    int n = it->get<int>();
+    return n > 0 ? n : DEFAULT_NUM_PREDICT * 4; // -1/-2: sin límite, la tratamos como larga
+}
+
+// Resultado de una consulta (sin formato de consola)
+struct QueryResult {
+    GenerateReply reply;
+    bool cached = false;
+    bool coalesced = false; // Respuesta compartida con otra petición idéntica en vuelo
+    float similarity = 0;   // > 0: respuesta de una pregunta parecida (tier semántico)
+    long long ms = 0;
+};
+
+// Cache global persistente (archivo mapeado en memoria). Se abre en el primer uso:
+// un proceso que solo reenvía al daemon (serve) no lo toca.
+inline PersistentCache& ollamaCache() {
+    static PersistentCache cache(defaultCachePath(), MAX_CACHE_SIZE, defaultCacheMaxBytes());
+    return cache;
+}
+
+// Clave binaria de 128 bits (modelo + prompt normalizado + opciones de muestreo).
+// dump() de un objeto json ya es canónico: claves ordenadas y sin espacios.
+inline CacheKey generateHash(const std::string& prompt, const std::string& model, const json& options) {
+    return requestFingerprint(model, "", cacheNormalizeEnabled() ? normalizePrompt(prompt) : prompt, options.dump());
+}
+
+// Ámbito del tier semántico: solo se reutilizan respuestas del mismo modelo y opciones
+inline uint64_t semanticScope(const std::string& model, const json& options) {
+    return KeyHasher().add("semantic").add(model).add(options.dump()).finish().prefix();
+}
+
+// Cliente principal de Ollama
+class OllamaClient {
+private:
+    std::string model;
+    EndpointPool endpoints;
+    int timeout;
+    CurlPool pool;
+    size_t maxInFlight;
+    RequestScheduler scheduler;
+    std::mutex workersMutex;
+    std::mutex inflightMutex;
+    std::unordered_map<CacheKey, std::shared_future<GenerateReply>, CacheKeyHash> inflight;
+    std::thread warmThread;
+    std::mutex warmMutex;
+    std::condition_variable warmWake;
+    bool warmStop = false;
+    SemanticIndex semanticIndex;
+    float semanticThreshold;
+    LatencyTracker latency;
+    bool hedging;
+    std::atomic<unsigned long long> hedgesSent{0};
+    std::atomic<unsigned long long> hedgesWon{0};
+    std::unique_ptr<ThreadPool> workers; // Último miembro: se detiene antes que el resto
+    
+    // Pool de hilos acotado para askAsync (se crea en el primer uso)
+    ThreadPool& executor() {
+        std::lock_guard<std::mutex> lock(workersMutex);
+        if (!workers) {
+            workers.reset(new ThreadPool(maxInFlight));
+        }
+        return *workers;
+    }
+    
+public:
+    OllamaClient(const std::string& m = DEFAULT_MODEL, 
+                 const std::string& ep = defaultEndpoint(), 
+                 int t = defaultTimeout(DEFAULT_TIMEOUT),
+                 size_t parallel = defaultParallelism()) 
+        : model(m), endpoints(ep), timeout(t), maxInFlight(parallel),
+          scheduler(defaultSchedulerSlots(parallel, endpoints.size())), semanticThreshold(defaultSemanticThreshold()),
+          hedging(defaultHedging()) {
+        endpoints.setAffinity(defaultAffinity());
+    }
+    
+    // El hilo de keepWarm usa el pool HTTP: se detiene antes de destruir los miembros
+    ~OllamaClient() {
+        stopKeepWarm();
+    }
+    
+    OllamaClient(const OllamaClient&) = delete;
+    OllamaClient& operator=(const OllamaClient&) = delete;
+    
+    // Consulta sin salida por consola: cache + HTTP (segura entre hilos).
+    // 'priority' ordena la petición en el planificador si hay que esperar hueco.
+    QueryResult query(const std::string& question, const json& options, bool useCache = true,
+                      Priority priority = Priority::Interactive) {
+        QueryResult result;
+        auto start = metricsNow();
+        auto elapsedMs = [&start]() {
+            recordSince(Phase::Total, start);
+            return std::chrono::duration_cast<std::chrono::milliseconds>(metricsNow() - start).count();
+        };
+        
+        if (!useCache) {
+            result.reply = generate(model, buildBody(question, options), predictedTokens(options), priority);
+            result.ms = elapsedMs();
+            return result;
+        }
+        
+        // Verificar cache (solo se guarda el texto de 'response')
+        auto lookupStart = metricsNow();
+        CacheKey hash = generateHash(question, model, options);
+        bool hit = cachedReply(hash, result.reply);
+        recordSince(Phase::CacheLookup, lookupStart);
+        if (hit) {
+            result.cached = true;
+            result.ms = elapsedMs();
+            return result;
+        }
+        
+        // Singleflight: si la misma huella ya está en vuelo, esperar esa respuesta
+        std::promise<GenerateReply> promise;
+        std::shared_future<GenerateReply> pending;
+        bool leader = false;
+        {
+            std::lock_guard<std::mutex> lock(inflightMutex);
+            auto it = inflight.find(hash);
+            if (it != inflight.end()) {
+                pending = it->second;
+            } else {
+                pending = promise.get_future().share();
+                inflight.emplace(hash, pending);
+                leader = true;
+            }
+        }
+        if (!leader) {
+            result.reply = pending.get();
+            result.coalesced = true;
+            result.ms = elapsedMs();
+            return result;
+        }
+        
+        // Otra petición pudo terminar entre el fallo de cache y el registro
+        if (cachedReply(hash, result.reply)) {
+            finishInflight(hash);
+            promise.set_value(result.reply);
+            result.cached = true;
+            result.ms = elapsedMs();
+            return result;
+        }
+        
+        // Tier semántico: una pregunta ya respondida con un embedding lo bastante parecido
+        std::vector<float> questionVector;
+        uint64_t scope = 0;
+        if (semanticThreshold > 0) {
+            auto semanticStart = metricsNow();
+            scope = semanticScope(model, options);
+            bool similar = false;
+            Embeddings e = embed(&question, 1, defaultEmbedModel());
+            if (e.ok && e.count == 1) {
+                questionVector.assign(e.row(0), e.row(0) + e.dim);
+                CacheKey similarKey;
+                float score = 0;
+                similar = semanticIndex.nearest(scope, questionVector.data(), questionVector.size(),
+                                                semanticThreshold, similarKey, score) &&
+                          cachedReply(similarKey, result.reply);
+                result.similarity = similar ? score : 0;
+            }
+            recordSince(Phase::SemanticLookup, semanticStart);
+            if (similar) {
+                // También bajo su propia clave: la próxima vez es un acierto exacto, sin embedding
+                ollamaCache().put(hash, *result.reply.text, CACHE_EXPIRY);
+                finishInflight(hash);
+                promise.set_value(result.reply);
+                result.cached = true;
+                result.ms = elapsedMs();
+                return result;
+            }
+        }
+        
+        // Realizar llamada HTTP
+        try {
+            result.reply = generate(model, buildBody(question, options), predictedTokens(options), priority);
+        } catch (...) {
+            finishInflight(hash);
+            promise.set_exception(std::current_exception());
+            throw;
+        }
+        result.ms = elapsedMs();
+        
+        // Guardar en cache antes de liberar la huella: los siguientes aciertan en cache
+        if (result.reply.ok) {
+            auto insertStart = metricsNow();
+            ollamaCache().put(hash, *result.reply.text, CACHE_EXPIRY);
+            recordSince(Phase::CacheInsert, insertStart);
+            if (!questionVector.empty()) {
+                semanticIndex.add(scope, questionVector.data(), questionVector.size(), hash);
+            }
+        }
+        finishInflight(hash);
+        promise.set_value(result.reply);
+        
+        return result;
+    }
+    
+    // Llamada síncrona con cache (sin salida por consola: la presentación es cosa del llamador)
+    GenerateReply ask(const std::string& question, bool useCache = true) {
+        return query(question, ASK_OPTIONS, useCache).reply;
+    }
+    
+    // Llamada asíncrona (pool acotado, usa el cache)
+    std::future<GenerateReply> askAsync(const std::string& question) {
+        return executor().submit([this, question]() {
+            return query(question, ASK_OPTIONS).reply;
+        });
+    }
+    
+    // Pregunta rápida (menos tokens)
+    GenerateReply askFast(const std::string& question, bool useCache = true) {
+        return query(question, FAST_OPTIONS, useCache).reply;
+    }
+    
+    // Llamada en streaming: cada token se entrega a 'onToken' en cuanto llega.
+    // Devuelve el último chunk (done=true) con los contadores; 'text' queda vacío.
+    GenerateReply askStream(const std::string& question, const std::function<void(const std::string&)>& onToken) {
+        GenerateReply final;
+        std::string token; // Reutilizado entre chunks
+        bool received = false; // Failover solo mientras no haya llegado ningún token
+        auto onLine = [&](const char* line, size_t len) {
+            received = true;
+            GenerateReply chunk;
+            if (!ReplyScanner(line, len).scan(token, chunk)) {
+                return;
+            }
+            if (!token.empty()) {
+                onToken(token);
+            }
+            if (!chunk.error.empty()) {
+                final.error = chunk.error;
+            }
+            if (chunk.done) {
+                chunk.ok = chunk.error.empty();
+                final = std::move(chunk);
+            }
+        };
+        
+        const std::string& body = buildBody(question, ASK_OPTIONS, true);
+        Endpoint* node = nullptr;
+        CURLcode streamRes = CURLE_OK;
+        HttpTiming timing;
+        thread_local std::string key;
+        latencyKey(key, model, predictedTokens(ASK_OPTIONS));
+        long requestTimeout = latency.timeoutFor(key, timeout);
+        auto waitStart = metricsNow();
+        SchedulerTicket ticket(scheduler, model, scheduler.estimate(model, predictedTokens(ASK_OPTIONS), body.size()),
+                               Priority::Interactive);
+        recordSince(Phase::QueueInteractive, waitStart);
+        auto sendStart = metricsNow();
+        CURLcode res = routed(model, node, [&](const std::string& url) {
+            // A mitad de respuesta no se reintenta: se corta con el error real
+            streamRes = httpStream(pool, url + "/api/generate", body, requestTimeout, onLine, &timing);
+            return received && streamRes != CURLE_OK ? CURLE_ABORTED_BY_CALLBACK : streamRes;
+        });
+        if (res != CURLE_OK) {
+            GenerateReply failed;
+            failed.error = curl_easy_strerror(streamRes != CURLE_OK ? streamRes : res);
+            return failed;
+        }
+        recordHttp(timing);
+        if (final.ok) {
+            endpoints.markServed(node, model);
+            recordOllama(final);
+            learnRates(model, final);
+            latency.record(key, std::chrono::duration_cast<std::chrono::milliseconds>(metricsNow() - sendStart).count());
+        }
+        
+        return final;
+    }
+    
+    // Turno de una sesión: reenvía 'context' y keep_alive para que Ollama no reevalúe
+    // el historial; el nuevo 'context' queda en la sesión. No usa el cache (depende del historial).
+    GenerateReply chat(Session& session, const std::string& question, const json& options = ASK_OPTIONS) {
+        if (session.model.empty()) {
+            session.model = model;
+        }
+        
+        // Cuerpo base + context/keep_alive añadidos al final, sin pasar los tokens por json
+        std::string body = json{
+            {"model", session.model},
+            {"prompt", question},
+            {"stream", false},
+            {"options", options},
+            {"keep_alive", session.keepAlive}
+        }.dump();
+        if (!session.context.empty()) {
+            body.pop_back();
+            body.reserve(body.size() + session.context.size() * 8 + 16);
+            body += ",\"context\":[";
+            char num[16];
+            for (size_t i = 0; i < session.context.size(); ++i) {
+                if (i > 0) {
+                    body += ',';
+                }
+                int n = std::snprintf(num, sizeof(num), "%d", static_cast<int>(session.context[i]));
+                body.append(num, n);
+            }
+            body += "]}";
+        }
+        
+        std::vector<int32_t> context;
+        GenerateReply reply = generate(session.model, body, predictedTokens(options), Priority::Interactive, &context);
+        if (reply.ok) {
+            if (!context.empty()) {
+                session.context.swap(context);
+            }
+            session.turns++;
+        }
+        return reply;
+    }
+    
+    // Embeddings de 'n' entradas, filas contiguas en el orden de 'inputs'. Las que ya están
+    // en el cache de vectores (por contenido) no se piden; el resto va en lotes a /api/embed.
+    Embeddings embed(const std::string* inputs, size_t n, const std::string& embedModel = defaultEmbedModel()) {
+        Embeddings result;
+        result.count = n;
+        PersistentCache& cache = embedCache();
+        
+        // Separar aciertos de cache y entradas a pedir (cada texto repetido se pide una vez)
+        std::vector<CacheKey> keys(n);
+        std::vector<std::pair<size_t, std::string>> hits;
+        std::vector<size_t> missing;
+        std::vector<std::pair<size_t, size_t>> duplicates; // (fila, fila de la que copiar)
+        std::unordered_map<CacheKey, size_t, CacheKeyHash> firstSeen;
+        std::string stored;
+        for (size_t i = 0; i < n; ++i) {
+            keys[i] = embedKey(embedModel, inputs[i]);
+            auto seen = firstSeen.emplace(keys[i], i);
+            if (!seen.second) {
+                duplicates.emplace_back(i, seen.first->second);
+            } else if (cache.get(keys[i], stored) && !stored.empty() && stored.size() % sizeof(float) == 0) {
+                hits.emplace_back(i, std::move(stored));
+            } else {
+                missing.push_back(i);
+            }
+        }
+        
+        std::string response;
+        std::vector<float> batch;
+        for (size_t start = 0; start < missing.size(); start += EMBED_BATCH_SIZE) {
+            size_t count = std::min(EMBED_BATCH_SIZE, missing.size() - start);
+            // Escapado directo: el texto de archivos puede no ser UTF-8 válido (dump() lanzaría)
+            std::string body = "{\"model\":\"";
+            appendJsonEscaped(body, embedModel);
+            body += "\",\"input\":[";
+            for (size_t k = 0; k < count; ++k) {
+                body += k > 0 ? ",\"" : "\"";
+                appendJsonEscaped(body, inputs[missing[start + k]]);
+                body += '"';
+            }
+            body += "]}";
+            Endpoint* node = nullptr;
+            HttpTiming timing;
+            CURLcode res = routed(embedModel, node, [&](const std::string& url) {
+                return httpRequest(pool, url + "/api/embed", body, timeout, response, &timing);
+            });
+            if (res != CURLE_OK) {
+                result.error = curl_easy_strerror(res);
+                return result;
+            }
+            recordHttp(timing);
+            
+            auto parseStart = metricsNow();
+            size_t rows = 0;
+            size_t dim = 0;
+            std::string text;
+            GenerateReply meta;
+            ReplyScanner scanner(response.data(), response.size());
+            scanner.captureEmbeddings(&batch, &rows, &dim);
+            bool scanned = scanner.scan(text, meta);
+            recordSince(Phase::Parse, parseStart);
+            if (!scanned || !meta.error.empty()) {
+                result.error = meta.error.empty() ? "respuesta inválida" : meta.error;
+                return result;
+            }
+            if (rows != count || dim == 0 || (result.dim != 0 && dim != result.dim)) {
+                result.error = "número o dimensión de vectores inesperados";
+                return result;
+            }
+            if (result.dim == 0) {
+                result.dim = dim;
+                result.data.assign(n * dim, 0.0f);
+            }
+            endpoints.markServed(node, embedModel);
+            
+            for (size_t k = 0; k < count; ++k) {
+                size_t i = missing[start + k];
+                const float* src = batch.data() + k * dim;
+                std::copy(src, src + dim, result.data.begin() + i * dim);
+                cache.put(keys[i], std::string(reinterpret_cast<const char*>(src), dim * sizeof(float)),
+                          EMBED_CACHE_EXPIRY);
+            }
+        }
+        
+        for (const auto& hit : hits) {
+            size_t dim = hit.second.size() / sizeof(float);
+            if (result.dim == 0) {
+                result.dim = dim;
+                result.data.assign(n * dim, 0.0f);
+            } else if (dim != result.dim) {
+                result.error = "dimensión de vectores inconsistente en el cache";
+                return result;
+            }
+            std::memcpy(result.data.data() + hit.first * dim, hit.second.data(), hit.second.size());
+        }
+        result.cached = hits.size();
+        for (const auto& dup : duplicates) {
+            std::copy(result.row(dup.second), result.row(dup.second) + result.dim,
+                      result.data.begin() + dup.first * result.dim);
+        }
+        result.ok = true;
+        return result;
+    }
+    
+    Embeddings embed(const std::vector<std::string>& inputs, const std::string& embedModel = defaultEmbedModel()) {
+        return embed(inputs.data(), inputs.size(), embedModel);
+    }
+    
+    // Precargar un modelo: generate con prompt vacío, Ollama solo lo carga y lo mantiene
+    // residente durante 'keepAlive'. loadDuration del resultado es el tiempo de carga.
+    GenerateReply preload(const std::string& targetModel, const std::string& keepAlive = DEFAULT_KEEP_ALIVE) {
+        std::string body = json{
+            {"model", targetModel},
+            {"prompt", ""},
+            {"stream", false},
+            {"keep_alive", keepAlive}
+        }.dump();
+        return generate(targetModel, body, 0, Priority::Batch);
+    }
+    
+    // Precargar 'models' ahora y cada 'intervalSeconds' en segundo plano (hasta stopKeepWarm)
+    void keepWarm(const std::vector<std::string>& models, const std::string& keepAlive, long intervalSeconds,
+                  const std::function<void(const std::string&, const GenerateReply&)>& onWarm = nullptr) {
+        stopKeepWarm();
+        warmStop = false;
+        warmThread = std::thread([this, models, keepAlive, intervalSeconds, onWarm]() {
+            std::unique_lock<std::mutex> lock(warmMutex);
+            while (!warmStop) {
+                lock.unlock();
+                for (const auto& m : models) {
+                    GenerateReply r = preload(m, keepAlive);
+                    if (onWarm) {
+                        onWarm(m, r);
+                    }
+                }
+                lock.lock();
+                if (intervalSeconds <= 0) {
+                    break;
+                }
+                warmWake.wait_for(lock, std::chrono::seconds(intervalSeconds), [this] { return warmStop; });
+            }
+        });
+    }
+    
+    void stopKeepWarm() {
+        if (!warmThread.joinable()) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(warmMutex);
+            warmStop = true;
+        }
+        warmWake.notify_all();
+        warmThread.join();
+    }
+    
+    // Límite de peticiones asíncronas en vuelo (usar antes de la primera askAsync)
+    void setMaxInFlight(size_t n) {
+        std::lock_guard<std::mutex> lock(workersMutex);
+        maxInFlight = n;
+        workers.reset();
+    }
+    
+    // Generaciones en curso a la vez contra los servidores (0 = sin planificador)
+    void setSchedulerSlots(size_t n) {
+        scheduler.setCapacity(n);
+    }
+    
+    RequestScheduler& requestScheduler() { return scheduler; }
+    
+    // Copia de respaldo a otro nodo cuando una petición pasa del p95 (necesita varios endpoints)
+    void setHedging(bool enabled) {
+        hedging = enabled;
+    }
+    
+    // Copias de respaldo enviadas y cuántas respondieron antes que la original
+    void hedgeCounts(unsigned long long& sent, unsigned long long& won) const {
+        sent = hedgesSent;
+        won = hedgesWon;
+    }
+    
+    // Cambiar modelo
+    void setModel(const std::string& newModel) {
+        model = newModel;
+    }
+    
+    const std::string& getModel() const { return model; }
+    
+    // Umbral del tier semántico (similitud coseno, 0 = desactivado); antes de las consultas
+    void setSemanticThreshold(float threshold) {
+        semanticThreshold = threshold;
+    }
+    
+    float getSemanticThreshold() const { return semanticThreshold; }
+    
+    size_t semanticIndexSize() {
+        return semanticIndex.size();
+    }
+    
+    // Mostrar estado
+    void status() {
+        std::cout << "🤖 Estado de Ollama:" << std::endl;
+        std::cout << "   Modelo: " << model << std::endl;
+        std::cout << "   Cache: " << ollamaCache().size() << " elementos" << std::endl;
+        
+        // Verificar conexión de cada nodo (/api/tags) y modelos cargados (/api/ps)
+        endpoints.healthCheck(pool);
+        for (size_t i = 0; i < endpoints.size(); ++i) {
+            Endpoint& e = endpoints.node(i);
+            std::cout << "   Endpoint: " << e.url
+                      << (e.healthy ? "  ✅ Servidor conectado" : "  ❌ Servidor no disponible");
+            if (e.failures > 0) {
+                std::cout << " (" << e.failures << " fallos)";
+            }
+            std::cout << std::endl;
+            if (!e.healthy) {
+                continue;
+            }
+            std::lock_guard<std::mutex> lock(e.modelsMutex);
+            for (const auto& m : e.loadedModels) {
+                std::cout << "      📦 " << m << std::endl;
+            }
+        }
+        if (endpoints.size() > 1) {
+            std::cout << "   Afinidad de modelo: " << (endpoints.affinityEnabled() ? "sí" : "no") << std::endl;
+        }
+        std::cout << "   Timeout: " << timeout << "s"
+                  << (adaptiveTimeoutEnabled() ? " hasta tener latencias, luego adaptativo (p99)" : "") << std::endl;
+        if (hedging && endpoints.size() > 1) {
+            std::cout << "   Hedging: copia a otro nodo al pasar el p95" << std::endl;
+        }
+        size_t slots = scheduler.getCapacity();
+        std::cout << "   Planificador: ";
+        if (slots == 0) {
+            std::cout << "desactivado" << std::endl;
+        } else {
+            std::cout << slots << " generaciones a la vez, interactivas antes que lote" << std::endl;
+        }
+    }
+    
+    // Afinidad: enviar cada modelo solo a nodos que ya lo tienen cargado (si hay alguno)
+    void setAffinity(bool enabled) {
+        endpoints.setAffinity(enabled);
+    }
+    
+    // Limpiar cache
+    void clearCache() {
+        ollamaCache().clear();
+    }
+    
+    // Estadísticas de cache
+    CacheStats cacheStats() const {
+        return ollamaCache().stats();
+    }
+    
+    // Cuerpo serializado de /api/generate, midiendo su construcción. Va al buffer del hilo
+    // (válido hasta la siguiente llamada en el mismo hilo): sin reservas una vez caliente.
+    const std::string& buildBody(const std::string& question, const json& options, bool stream = false) const {
+        auto buildStart = metricsNow();
+        thread_local std::string body;
+        requestTemplate(options, stream).build(question, body);
+        recordSince(Phase::JsonBuild, buildStart);
+        return body;
+    }
+    
+    // Cuerpo de /api/generate como DOM (referencia para ollama_bench)
+    json requestBody(const std::string& question, const json& options, bool stream) const {
+        return {
+            {"model", model},
+            {"prompt", question},
+            {"stream", stream},
+            {"options", options}
+        };
+    }
+    
+private:
+    // Plantilla de (modelo, opciones, stream) en la cache del hilo: las opciones se comparan
+    // por valor, así que solo la primera petición de cada combinación hace dump()
+    const RequestTemplate& requestTemplate(const json& options, bool stream) const {
+        struct Compiled {
+            std::string model;
+            json options;
+            bool stream;
+            RequestTemplate tpl;
+        };
+        thread_local std::vector<Compiled> compiled;
+        for (const Compiled& c : compiled) {
+            if (c.stream == stream && c.model == model && c.options == options) {
+                return c.tpl;
+            }
+        }
+        if (compiled.size() >= REQUEST_TEMPLATE_CACHE) {
+            compiled.erase(compiled.begin());
+        }
+        compiled.push_back({model, options, stream, RequestTemplate(model, options.dump(), stream)});
+        return compiled.back().tpl;
+    }
+    
+    // Fases de red de libcurl
+    static void recordHttp(const HttpTiming& timing) {
+        recordUs(Phase::Connect, timing.connectUs);
+        recordUs(Phase::Ttfb, timing.ttfbUs);
+        recordUs(Phase::Transfer, timing.transferUs);
+    }
+    
+    // Duraciones que reporta Ollama (nanosegundos) para separar modelo de red
+    static void recordOllama(const GenerateReply& reply) {
+        if (reply.loadDuration > 0) {
+            recordUs(Phase::OllamaLoad, reply.loadDuration / 1000);
+        }
+        if (reply.promptEvalDuration > 0) {
+            recordUs(Phase::OllamaPromptEval, reply.promptEvalDuration / 1000);
+        }
+        if (reply.evalDuration > 0) {
+            recordUs(Phase::OllamaEval, reply.evalDuration / 1000);
+        }
+    }
+    
+    bool cachedReply(const CacheKey& hash, GenerateReply& reply) {
+        std::string stored;
+        if (!ollamaCache().get(hash, stored)) {
+            return false;
+        }
+        reply.text = std::make_shared<const std::string>(std::move(stored));
+        reply.ok = true;
+        reply.done = true;
+        return true;
+    }
+    
+    // ms/token de esta respuesta para estimar la duración de las siguientes del modelo
+    void learnRates(const std::string& targetModel, const GenerateReply& reply) {
+        scheduler.observe(targetModel, reply.evalCount, reply.evalDuration, reply.promptEvalCount,
+                          reply.promptEvalDuration);
+    }
+    
+    void finishInflight(const CacheKey& hash) {
+        std::lock_guard<std::mutex> lock(inflightMutex);
+        inflight.erase(hash);
+    }
+    
+    // Enviar al nodo con menos peticiones en curso; ante error de conexión o timeout,
+    // marcarlo caído y reintentar en el siguiente. 'node' recibe el nodo que respondió.
+    template <typename Send>
+    CURLcode routed(const std::string& targetModel, Endpoint*& node, Send send) {
+        endpoints.refreshAffinityIfStale(pool);
+        std::vector<Endpoint*> tried;
+        CURLcode res = CURLE_COULDNT_CONNECT;
+        while (Endpoint* e = endpoints.pick(targetModel, tried)) {
+            {
+                EndpointLease lease(e);
+                res = send(e->url);
+            }
+            node = e;
+            if (!isFailoverError(res)) {
+                e->healthy = true;
+                return res;
+            }
+            endpoints.markDown(e); // Los fallos por nodo se ven en status()
+            // Solo un vector pequeño: la mayoría de peticiones no llega aquí
+            tried.push_back(e);
+        }
+        return res;
+    }
+    
+    // La misma petición en dos nodos: la segunda sale si la primera pasa de 'hedgeAfterMs'
+    CURLcode hedgedGenerate(const std::string& targetModel, const std::string& body, long requestTimeout,
+                            long long hedgeAfterMs, std::string& response, HttpTiming& timing, Endpoint*& node) {
+        endpoints.refreshAffinityIfStale(pool);
+        Endpoint* primary = endpoints.pick(targetModel, {});
+        Endpoint* backup = primary ? endpoints.pick(targetModel, {primary}) : nullptr;
+        if (!backup || backup == primary) {
+            return routed(targetModel, node, [&](const std::string& url) {
+                return httpRequest(pool, url + "/api/generate", body, requestTimeout, response, &timing);
+            });
+        }
+        int winner = -1;
+        bool hedged = false;
+        CURLcode res;
+        {
+            EndpointLease lease(primary);
+            res = httpHedged(pool, primary->url + "/api/generate", backup->url + "/api/generate", body,
+                             requestTimeout, hedgeAfterMs, [&] {
+                                 hedged = true;
+                                 backup->outstanding++;
+                                 hedgesSent++;
+                             }, response, &timing, winner);
+        }
+        if (hedged) {
+            backup->outstanding--;
+        }
+        if (winner == 1) {
+            hedgesWon++;
+        }
+        node = winner == 1 ? backup : primary;
+        if (isFailoverError(res)) {
+            endpoints.markDown(primary);
+            if (hedged) {
+                endpoints.markDown(backup);
+            }
+        }
+        return res;
+    }
+    
+    // POST /api/generate sin DOM: el cuerpo va a un buffer por hilo y se escanea en el sitio.
+    // Antes, un hueco del planificador según la prioridad y los tokens esperados. El timeout
+    // sale de la latencia de este modelo y num_predict; con hedging, la copia sale en el p95.
+    GenerateReply generate(const std::string& targetModel, const std::string& body, int numPredict,
+                           Priority priority, std::vector<int32_t>* context = nullptr) {
+        thread_local std::string response;
+        Endpoint* node = nullptr;
+        HttpTiming timing;
+        thread_local std::string key;
+        latencyKey(key, targetModel, numPredict);
+        long requestTimeout = latency.timeoutFor(key, timeout);
+        // Sin copia para las precargas (num_predict 0): cargarían el modelo en dos nodos
+        long long hedgeAfterMs = hedging && numPredict > 0 && endpoints.size() > 1 ? latency.hedgeDelayMs(key) : 0;
+        auto waitStart = metricsNow();
+        SchedulerTicket ticket(scheduler, targetModel, scheduler.estimate(targetModel, numPredict, body.size()),
+                               priority);
+        recordSince(priority == Priority::Batch ? Phase::QueueBatch : Phase::QueueInteractive, waitStart);
+        auto sendStart = metricsNow();
+        CURLcode res = hedgeAfterMs > 0
+            ? hedgedGenerate(targetModel, body, requestTimeout, hedgeAfterMs, response, timing, node)
+            : routed(targetModel, node, [&](const std::string& url) {
+                  return httpRequest(pool, url + "/api/generate", body, requestTimeout, response, &timing);
+              });
+        
+        if (res != CURLE_OK) {
+            GenerateReply failed;
+            failed.error = curl_easy_strerror(res);
+            return failed;
+        }
+        
+        recordHttp(timing);
+        
+        auto parseStart = metricsNow();
+        GenerateReply reply = scanGenerateReply(response, context);
+        recordSince(Phase::Parse, parseStart);
+        if (reply.error.empty() && !reply.ok) {
+            reply.error = "respuesta JSON inválida";
+        } else if (reply.ok) {
+            endpoints.markServed(node, targetModel);
+            recordOllama(reply);
+            learnRates(targetModel, reply);
+            latency.record(key, std::chrono::duration_cast<std::chrono::milliseconds>(metricsNow() - sendStart).count());
+        }
+        return reply;
+    }
+};
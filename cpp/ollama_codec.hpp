@@ -0,0 +1,116 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <zlib.h>
+#ifdef OLLAMA_WITH_LZ4
+#include <lz4.h>
+#endif
+#ifdef OLLAMA_WITH_ZSTD
+#include <zstd.h>
+#endif
+
+// Compresión de valores del cache. zlib siempre está disponible (lo trae libcurl);
+// LZ4 y zstd se activan al compilar: make CODEC=lz4 / make CODEC=zstd
+const uint8_t CODEC_NONE = 0;
+const uint8_t CODEC_ZLIB = 1;
+const uint8_t CODEC_LZ4 = 2;
+const uint8_t CODEC_ZSTD = 3;
+
+const size_t CODEC_MIN_SIZE = 512; // Por debajo no compensa: la cabecera del códec se come la ganancia
+
+#if defined(OLLAMA_WITH_ZSTD)
+const uint8_t CODEC_DEFAULT = CODEC_ZSTD;
+#elif defined(OLLAMA_WITH_LZ4)
+const uint8_t CODEC_DEFAULT = CODEC_LZ4;
+#else
+const uint8_t CODEC_DEFAULT = CODEC_ZLIB;
+#endif
+
+#ifdef OLLAMA_WITH_ZSTD
+// Contextos de zstd por hilo: crearlos en cada llamada cuesta más que comprimir 4 KB
+struct ZstdContexts {
+    ZSTD_CCtx* compress = ZSTD_createCCtx();
+    ZSTD_DCtx* decompress = ZSTD_createDCtx();
+    ~ZstdContexts() {
+        ZSTD_freeCCtx(compress);
+        ZSTD_freeDCtx(decompress);
+    }
+};
+
+inline ZstdContexts& zstdContexts() {
+    thread_local ZstdContexts ctx;
+    return ctx;
+}
+#endif
+
+inline const char* codecName(uint8_t codec) {
+    switch (codec) {
+        case CODEC_ZLIB: return "zlib";
+        case CODEC_LZ4: return "lz4";
+        case CODEC_ZSTD: return "zstd";
+        default: return "none";
+    }
+}
+
+// Comprimir 'len' bytes en 'out' con el códec por defecto. Devuelve el códec usado:
+// CODEC_NONE si el valor es pequeño o no se reduce (entonces se guarda tal cual y 'out' se ignora).
+inline uint8_t compressValue(const char* data, size_t len, std::string& out) {
+    if (len < CODEC_MIN_SIZE) {
+        return CODEC_NONE;
+    }
+#if defined(OLLAMA_WITH_ZSTD)
+    out.resize(ZSTD_compressBound(len));
+    size_t n = ZSTD_compressCCtx(zstdContexts().compress, &out[0], out.size(), data, len, 1);
+    if (ZSTD_isError(n) || n >= len) {
+        return CODEC_NONE;
+    }
+    out.resize(n);
+    return CODEC_ZSTD;
+#elif defined(OLLAMA_WITH_LZ4)
+    int bound = LZ4_compressBound(static_cast<int>(len));
+    out.resize(static_cast<size_t>(bound));
+    int n = LZ4_compress_default(data, &out[0], static_cast<int>(len), bound);
+    if (n <= 0 || static_cast<size_t>(n) >= len) {
+        return CODEC_NONE;
+    }
+    out.resize(static_cast<size_t>(n));
+    return CODEC_LZ4;
+#else
+    uLongf n = compressBound(static_cast<uLong>(len));
+    out.resize(n);
+    if (compress2(reinterpret_cast<Bytef*>(&out[0]), &n, reinterpret_cast<const Bytef*>(data),
+                  static_cast<uLong>(len), Z_BEST_SPEED) != Z_OK || n >= len) {
+        return CODEC_NONE;
+    }
+    out.resize(n);
+    return CODEC_ZLIB;
+#endif
+}
+
+// Descomprimir a 'out' (tamaño original conocido). false si el códec no está compilado
+// en este binario o los datos no cuadran: el llamador lo trata como un fallo de cache.
+inline bool decompressValue(uint8_t codec, const char* data, size_t len, size_t rawLen, std::string& out) {
+    if (codec == CODEC_NONE) {
+        out.assign(data, len);
+        return true;
+    }
+    out.resize(rawLen);
+    if (codec == CODEC_ZLIB) {
+        uLongf n = static_cast<uLongf>(rawLen);
+        return uncompress(reinterpret_cast<Bytef*>(&out[0]), &n, reinterpret_cast<const Bytef*>(data),
+                          static_cast<uLong>(len)) == Z_OK && n == rawLen;
+    }
+#ifdef OLLAMA_WITH_LZ4
+    if (codec == CODEC_LZ4) {
+        return LZ4_decompress_safe(data, &out[0], static_cast<int>(len), static_cast<int>(rawLen)) ==
+               static_cast<int>(rawLen);
+    }
+#endif
+#ifdef OLLAMA_WITH_ZSTD
+    if (codec == CODEC_ZSTD) {
+        return ZSTD_decompressDCtx(zstdContexts().decompress, &out[0], rawLen, data, len) == rawLen;
+    }
+#endif
+    return false;
+}
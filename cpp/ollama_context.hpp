@@ -0,0 +1,419 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <set>
+#include <unordered_set>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <filesystem>
+#include <fstream>
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include "ollama_hash.hpp"
+#include "ollama_mmap.hpp"
+
+// Contexto de proyecto para ask --context: recorrido del árbol en paralelo, archivos mapeados
+// en memoria (sin streams), binarios e ignorados fuera, y el contenido partido en trozos por
+// líneas con su hash. Con el presupuesto de tokens de la ventana se eligen los trozos.
+
+// Tipos que se leen al recorrer un directorio (los de get_project_files en Python, más C/C++).
+// Con un glob (src/**/*.cpp) decide el patrón.
+const std::set<std::string> CONTEXT_EXTENSIONS = {
+    ".py", ".js", ".html", ".css", ".json", ".md", ".txt", ".cpp", ".hpp", ".h", ".c"
+};
+// Directorios que nunca aportan contexto (además de los ocultos y de .gitignore)
+const std::set<std::string> CONTEXT_IGNORED_DIRS = {
+    "node_modules", "__pycache__", "venv", "build", "dist", "target", "out", "bin", "obj"
+};
+const uint64_t CONTEXT_MAX_FILE_SIZE = 1 << 20;  // Más no es código fuente: se omite
+const size_t CONTEXT_BINARY_PROBE = 8000;        // Bytes en los que se busca un NUL (como git)
+const size_t CONTEXT_CHUNK_TOKENS = 256;         // Tamaño de cada trozo
+const size_t CONTEXT_BYTES_PER_TOKEN = 3;        // Estimación prudente para código (prosa ~4)
+const size_t CONTEXT_RESERVE_TOKENS = 64;        // Margen para la plantilla del modelo
+const int DEFAULT_NUM_CTX = 4096;
+const size_t CONTEXT_MAX_THREADS = 8;
+
+// Ventana de contexto del modelo en tokens (OLLAMA_NUM_CTX si está definido)
+inline int defaultNumCtx() {
+    const char* env = std::getenv("OLLAMA_NUM_CTX");
+    if (env && *env) {
+        long n = std::strtol(env, nullptr, 10);
+        if (n > 0) {
+            return static_cast<int>(n);
+        }
+    }
+    return DEFAULT_NUM_CTX;
+}
+
+inline size_t estimateTokens(size_t bytes) {
+    return (bytes + CONTEXT_BYTES_PER_TOKEN - 1) / CONTEXT_BYTES_PER_TOKEN;
+}
+
+// Glob sobre rutas con '/': '*' y '?' no cruzan directorios, '**' sí ("**/" casa también
+// con ningún directorio)
+inline bool globMatch(const char* p, const char* s) {
+    while (*p) {
+        if (p[0] == '*' && p[1] == '*') {
+            p += 2;
+            if (*p == '/') {
+                ++p;
+            }
+            for (const char* t = s;; ++t) {
+                if (globMatch(p, t)) {
+                    return true;
+                }
+                if (!*t) {
+                    return false;
+                }
+            }
+        }
+        if (*p == '*') {
+            ++p;
+            for (const char* t = s;; ++t) {
+                if (globMatch(p, t)) {
+                    return true;
+                }
+                if (!*t || *t == '/') {
+                    return false;
+                }
+            }
+        }
+        if (!*s || (*p == '?' ? *s == '/' : *p != *s)) {
+            return false;
+        }
+        ++p;
+        ++s;
+    }
+    return !*s;
+}
+
+// Reglas de .gitignore en la raíz del recorrido: nombres y globs, 'dir/' solo para directorios,
+// '/x' anclado a la raíz. Las negaciones (!) no se soportan y se saltan.
+class IgnoreRules {
+private:
+    struct Rule {
+        std::string pattern;
+        bool dirOnly;
+        bool anchored; // Con '/' se compara la ruta relativa; sin él, el nombre
+    };
+    std::vector<Rule> rules;
+
+public:
+    void load(const std::filesystem::path& root) {
+        std::ifstream f(root / ".gitignore");
+        std::string line;
+        while (std::getline(f, line)) {
+            while (!line.empty() && (line.back() == '\r' || line.back() == ' ')) {
+                line.pop_back();
+            }
+            if (line.empty() || line[0] == '#' || line[0] == '!') {
+                continue;
+            }
+            Rule r;
+            r.dirOnly = line.back() == '/';
+            if (r.dirOnly) {
+                line.pop_back();
+            }
+            if (!line.empty() && line[0] == '/') {
+                line.erase(0, 1);
+            }
+            r.anchored = line.find('/') != std::string::npos;
+            r.pattern = line;
+            if (!r.pattern.empty()) {
+                rules.push_back(std::move(r));
+            }
+        }
+    }
+
+    // 'rel' relativa a la raíz con '/', 'name' el último componente
+    bool ignored(const std::string& rel, const std::string& name, bool isDir) const {
+        for (const Rule& r : rules) {
+            if (r.dirOnly && !isDir) {
+                continue;
+            }
+            if (globMatch(r.pattern.c_str(), r.anchored ? rel.c_str() : name.c_str())) {
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+// Un trozo de archivo: origen (ruta:línea), texto y su hash de contenido. El hash identifica
+// el fragmento entre ejecuciones: mismo texto = mismo embedding en cache y mismo trozo de prompt.
+struct ContextChunk {
+    std::string origin;
+    size_t line = 1;
+    std::string text;
+    CacheKey key;
+    size_t tokens = 0; // Estimación del fragmento ya formateado
+};
+
+struct ContextFiles {
+    std::vector<ContextChunk> chunks;
+    size_t files = 0;
+    size_t binary = 0;   // Omitidos por contener NUL
+    size_t large = 0;    // Omitidos por pasar de CONTEXT_MAX_FILE_SIZE
+    size_t ignored = 0;  // Entradas saltadas (ocultas, CONTEXT_IGNORED_DIRS, .gitignore)
+    uint64_t bytes = 0;
+};
+
+// Cabecera con la que cada trozo entra en el prompt
+inline std::string contextHeader(const ContextChunk& c) {
+    return "=== " + c.origin + ":" + std::to_string(c.line) + " ===\n";
+}
+
+// Partir en trozos de hasta 'chunkBytes' cortando en fin de línea si se puede (y si no, fuera
+// de una secuencia UTF-8). Los trozos solo con espacios se saltan.
+inline void chunkText(const std::string& origin, const char* data, size_t n, size_t chunkBytes,
+                      std::vector<ContextChunk>& out) {
+    size_t pos = 0;
+    size_t line = 1;
+    while (pos < n) {
+        size_t len = std::min(chunkBytes, n - pos);
+        if (pos + len < n) {
+            // Último salto de línea de la segunda mitad; sin él, no partir un carácter UTF-8
+            size_t cut = pos + len;
+            while (cut > pos + len / 2 && data[cut - 1] != '\n') {
+                cut--;
+            }
+            if (cut > pos + len / 2) {
+                len = cut - pos;
+            } else {
+                while (len > 1 && (static_cast<unsigned char>(data[pos + len]) & 0xC0) == 0x80) {
+                    len--;
+                }
+            }
+        }
+        const char* chunk = data + pos;
+        size_t lines = static_cast<size_t>(std::count(chunk, chunk + len, '\n'));
+        bool blank = std::all_of(chunk, chunk + len, [](char c) {
+            return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+        });
+        if (!blank) {
+            ContextChunk c;
+            c.origin = origin;
+            c.line = line;
+            c.text.assign(chunk, len);
+            c.key = KeyHasher().add("context").add(c.text).finish();
+            c.tokens = estimateTokens(contextHeader(c).size() + len + 1);
+            out.push_back(std::move(c));
+        }
+        line += lines;
+        pos += len;
+    }
+}
+
+inline size_t contextThreads() {
+    size_t n = std::thread::hardware_concurrency();
+    return std::max<size_t>(1, std::min(n, CONTEXT_MAX_THREADS));
+}
+
+// Archivos de 'spec' (archivo, directorio o glob), ordenados por ruta. Los directorios se
+// reparten entre hilos: cada uno lista el suyo y encola los subdirectorios que encuentra.
+// 'labels' es la ruta tal como se mostrará (relativa a la raíz del glob o del directorio).
+inline void walkContext(const std::string& spec, std::vector<std::string>& paths, std::vector<std::string>& labels,
+                        size_t& ignoredCount) {
+    namespace fs = std::filesystem;
+    std::error_code ec;
+    size_t wild = spec.find_first_of("*?");
+    if (wild == std::string::npos && !fs::is_directory(spec, ec)) {
+        if (fs::is_regular_file(spec, ec)) {
+            paths.push_back(spec);
+            labels.push_back(spec);
+        }
+        return;
+    }
+    // Raíz = lo anterior al primer componente con comodines; el resto es el patrón relativo
+    fs::path root = spec;
+    std::string pattern;
+    if (wild != std::string::npos) {
+        size_t slash = spec.rfind('/', wild);
+        root = slash == std::string::npos ? fs::path(".") : fs::path(slash == 0 ? "/" : spec.substr(0, slash));
+        pattern = slash == std::string::npos ? spec : spec.substr(slash + 1);
+    }
+    IgnoreRules rules;
+    rules.load(root);
+
+    struct Found {
+        std::string rel;
+        fs::path path;
+    };
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::deque<std::pair<fs::path, std::string>> pending = {{root, ""}};
+    size_t busy = 0;
+    std::vector<Found> found;
+    std::atomic<size_t> skipped{0};
+
+    auto worker = [&]() {
+        std::vector<std::pair<fs::path, std::string>> subdirs;
+        std::vector<Found> files;
+        for (;;) {
+            std::pair<fs::path, std::string> dir;
+            {
+                std::unique_lock<std::mutex> lock(mtx);
+                cv.wait(lock, [&] { return !pending.empty() || busy == 0; });
+                if (pending.empty()) {
+                    return;
+                }
+                dir = std::move(pending.front());
+                pending.pop_front();
+                busy++;
+            }
+            std::error_code dirEc;
+            for (fs::directory_iterator it(dir.first, fs::directory_options::skip_permission_denied, dirEc), end;
+                 !dirEc && it != end; it.increment(dirEc)) {
+                std::string name = it->path().filename().string();
+                std::string rel = dir.second.empty() ? name : dir.second + "/" + name;
+                std::error_code stEc;
+                // Sin seguir enlaces a directorios: evita ciclos y salir del árbol
+                bool isDir = it->is_directory(stEc) && !it->is_symlink(stEc);
+                bool isFile = !isDir && it->is_regular_file(stEc);
+                if (!isDir && !isFile) {
+                    continue;
+                }
+                if ((!name.empty() && name[0] == '.') || (isDir && CONTEXT_IGNORED_DIRS.count(name)) ||
+                    rules.ignored(rel, name, isDir)) {
+                    skipped++;
+                    continue;
+                }
+                if (isDir) {
+                    subdirs.emplace_back(it->path(), rel);
+                } else if (pattern.empty() ? CONTEXT_EXTENSIONS.count(it->path().extension().string()) > 0
+                                           : globMatch(pattern.c_str(), rel.c_str())) {
+                    files.push_back({rel, it->path()});
+                }
+            }
+            std::lock_guard<std::mutex> lock(mtx);
+            for (auto& d : subdirs) {
+                pending.push_back(std::move(d));
+            }
+            for (auto& f : files) {
+                found.push_back(std::move(f));
+            }
+            subdirs.clear();
+            files.clear();
+            busy--;
+            cv.notify_all();
+        }
+    };
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < contextThreads(); ++i) {
+        threads.emplace_back(worker);
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    std::sort(found.begin(), found.end(), [](const Found& a, const Found& b) { return a.rel < b.rel; });
+    bool showRoot = root.generic_string() != ".";
+    for (auto& f : found) {
+        labels.push_back(showRoot ? (root / f.rel).generic_string() : f.rel);
+        paths.push_back(f.path.string());
+    }
+    ignoredCount += skipped;
+}
+
+// Leer y trocear los archivos de 'spec' en paralelo (cada hilo mapea los suyos). El orden de
+// los trozos es el de las rutas: el mismo árbol produce siempre los mismos fragmentos.
+inline void loadContext(const std::string& spec, size_t chunkBytes, ContextFiles& out) {
+    std::vector<std::string> paths;
+    std::vector<std::string> labels;
+    walkContext(spec, paths, labels, out.ignored);
+
+    std::vector<std::vector<ContextChunk>> perFile(paths.size());
+    std::atomic<size_t> next{0};
+    std::atomic<size_t> files{0}, binary{0}, large{0};
+    std::atomic<uint64_t> bytes{0};
+    auto worker = [&]() {
+        for (size_t i = next++; i < paths.size(); i = next++) {
+            MappedFile file;
+            if (!file.openReadOnly(paths[i])) {
+                continue;
+            }
+            uint64_t size = file.size();
+            if (size > CONTEXT_MAX_FILE_SIZE) {
+                large++;
+                continue;
+            }
+            const char* data = file.data();
+            size_t n = static_cast<size_t>(size);
+            if (n > 0 && std::memchr(data, 0, std::min(n, CONTEXT_BINARY_PROBE))) {
+                binary++;
+                continue;
+            }
+            chunkText(labels[i], data, n, chunkBytes, perFile[i]);
+            files++;
+            bytes += size;
+        }
+    };
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < std::min(contextThreads(), paths.size()); ++i) {
+        threads.emplace_back(worker);
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    for (auto& chunks : perFile) {
+        for (auto& c : chunks) {
+            out.chunks.push_back(std::move(c));
+        }
+    }
+    out.files += files;
+    out.binary += binary;
+    out.large += large;
+    out.bytes += bytes;
+}
+
+// Trozos que entran en 'budgetTokens': por relevancia si hay 'scores' (uno por trozo), si no
+// en orden. Los repetidos (mismo hash) entran una vez. Se devuelven en el orden original,
+// así que un árbol sin cambios da el mismo prefijo de prompt.
+inline std::vector<size_t> selectContext(const std::vector<ContextChunk>& chunks, size_t budgetTokens,
+                                         const std::vector<float>* scores) {
+    std::vector<size_t> order(chunks.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        order[i] = i;
+    }
+    if (scores) {
+        std::stable_sort(order.begin(), order.end(), [scores](size_t a, size_t b) {
+            return (*scores)[a] > (*scores)[b];
+        });
+    }
+    std::vector<size_t> selected;
+    std::unordered_set<CacheKey, CacheKeyHash> seen;
+    size_t used = 0;
+    for (size_t i : order) {
+        if (used + chunks[i].tokens > budgetTokens || !seen.insert(chunks[i].key).second) {
+            continue;
+        }
+        used += chunks[i].tokens;
+        selected.push_back(i);
+    }
+    std::sort(selected.begin(), selected.end());
+    return selected;
+}
+
+// Prompt final: el contexto delante (prefijo estable, Ollama reutiliza lo ya evaluado)
+// y la pregunta al final
+inline std::string composeContextPrompt(const std::vector<ContextChunk>& chunks, const std::vector<size_t>& selected,
+                                        const std::string& question) {
+    std::string prompt = "Contexto del proyecto:\n\n";
+    for (size_t i : selected) {
+        prompt += contextHeader(chunks[i]);
+        prompt += chunks[i].text;
+        if (prompt.back() != '\n') {
+            prompt += '\n';
+        }
+        prompt += '\n';
+    }
+    prompt += "Pregunta: ";
+    prompt += question;
+    return prompt;
+}
@@ -0,0 +1,180 @@
+#pragma once
+
+#include <string>
+#include "ollama_client.hpp"
+#include "ollama_ipc.hpp"
+
+// Protocolo del daemon sobre las tramas de ollama_ipc.hpp (enteros little-endian):
+//   ask/fast    -> [op | prioridad de lote][u16 longitud del modelo][modelo][pregunta]
+//              <- [estado][flags u8][ms u32][eval_count u32][similitud x 1e6 u32][texto, o el error si estado != OK]
+//   cachestats  -> [op]
+//              <- [estado][total valid expired compressed: u32][totalAccess bytes rawBytes fileBytes byteBudget: u64]
+//   metrics     -> [op][1 = Prometheus, 0 = JSON]
+//              <- [estado][texto]
+const uint8_t DAEMON_OP_ASK = 1;
+const uint8_t DAEMON_OP_FAST = 2;
+const uint8_t DAEMON_OP_CACHESTATS = 3;
+const uint8_t DAEMON_OP_METRICS = 4;
+const uint8_t DAEMON_OP_BATCH = 0x80; // Bit del op: la pregunta entra al planificador como de lote
+
+const uint8_t DAEMON_OK = 0;
+const uint8_t DAEMON_FAILED = 1;      // La consulta falló (error de Ollama o de red)
+const uint8_t DAEMON_UNSUPPORTED = 2; // Operación desconocida u otro modelo: el cliente lo hace en local
+
+const uint8_t DAEMON_FLAG_CACHED = 1;
+const uint8_t DAEMON_FLAG_COALESCED = 2;
+
+const size_t DAEMON_QUERY_HEADER = 1 + 1 + 4 + 4 + 4;
+const size_t DAEMON_STATS_SIZE = 1 + 4 * 4 + 5 * 8;
+
+// Lado servidor: un OllamaClient (cache, conexiones, pool de hilos) compartido por todas
+// las conexiones; query() ya es segura entre hilos y agrupa peticiones idénticas.
+class DaemonServer {
+private:
+    OllamaClient& client;
+    IpcServer server;
+
+    void handle(const std::string& request, std::string& response) {
+        uint8_t op = request.empty() ? 0 : static_cast<uint8_t>(request[0]);
+        Priority priority = (op & DAEMON_OP_BATCH) ? Priority::Batch : Priority::Interactive;
+        op &= static_cast<uint8_t>(~DAEMON_OP_BATCH);
+        if ((op == DAEMON_OP_ASK || op == DAEMON_OP_FAST) && request.size() >= 3) {
+            size_t modelLen = static_cast<unsigned char>(request[1]) | (static_cast<unsigned char>(request[2]) << 8);
+            if (3 + modelLen > request.size()) {
+                response += static_cast<char>(DAEMON_UNSUPPORTED);
+                return;
+            }
+            // Otro modelo: el estado del daemon no es de ese cliente
+            if (modelLen > 0 && request.compare(3, modelLen, client.getModel()) != 0) {
+                response += static_cast<char>(DAEMON_UNSUPPORTED);
+                return;
+            }
+            std::string question = request.substr(3 + modelLen);
+            QueryResult r = client.query(question, op == DAEMON_OP_FAST ? FAST_OPTIONS : ASK_OPTIONS, true, priority);
+            response += static_cast<char>(r.reply.ok ? DAEMON_OK : DAEMON_FAILED);
+            response += static_cast<char>((r.cached ? DAEMON_FLAG_CACHED : 0) | (r.coalesced ? DAEMON_FLAG_COALESCED : 0));
+            ipcPutU32(response, static_cast<uint32_t>(r.ms));
+            ipcPutU32(response, static_cast<uint32_t>(r.reply.evalCount));
+            ipcPutU32(response, static_cast<uint32_t>(r.similarity * 1e6f));
+            if (r.reply.ok) {
+                response.append(r.reply.response().data(), r.reply.response().size());
+            } else {
+                response += r.reply.error;
+            }
+        } else if (op == DAEMON_OP_CACHESTATS) {
+            CacheStats st = client.cacheStats();
+            response += static_cast<char>(DAEMON_OK);
+            ipcPutU32(response, static_cast<uint32_t>(st.total));
+            ipcPutU32(response, static_cast<uint32_t>(st.valid));
+            ipcPutU32(response, static_cast<uint32_t>(st.expired));
+            ipcPutU32(response, static_cast<uint32_t>(st.compressed));
+            ipcPutU64(response, static_cast<uint64_t>(st.totalAccess));
+            ipcPutU64(response, st.bytes);
+            ipcPutU64(response, st.rawBytes);
+            ipcPutU64(response, st.fileBytes);
+            ipcPutU64(response, st.byteBudget);
+        } else if (op == DAEMON_OP_METRICS) {
+            MetricsSnapshot snapshot = metrics().snapshot();
+            bool prometheus = request.size() > 1 && request[1] == 1;
+            response += static_cast<char>(DAEMON_OK);
+            response += prometheus ? metricsPrometheus(snapshot) : metricsJson(snapshot) + "\n";
+        } else {
+            response += static_cast<char>(DAEMON_UNSUPPORTED);
+        }
+    }
+
+public:
+    explicit DaemonServer(OllamaClient& c)
+        : client(c), server([this](const std::string& req, std::string& resp) { handle(req, resp); }) {}
+
+    bool start(const std::string& path = defaultIpcPath()) { return server.start(path); }
+    void stop() { server.stop(); }
+    const std::string& socketPath() const { return server.socketPath(); }
+    unsigned long long requestsServed() const { return server.requestsServed(); }
+};
+
+// Lado cliente: una conexión para todas las peticiones del proceso.
+// Cada método devuelve false si el daemon no respondió o no atiende la petición;
+// entonces el llamador la hace en local.
+class DaemonClient {
+private:
+    IpcConnection conn;
+    std::string request;
+    std::string response;
+
+    bool roundTrip() {
+        if (!conn.valid()) {
+            return false;
+        }
+        if (!conn.writeFrame(request) || !conn.readFrame(response) || response.empty()) {
+            conn.close();
+            return false;
+        }
+        return static_cast<uint8_t>(response[0]) != DAEMON_UNSUPPORTED;
+    }
+
+public:
+    bool connect(const std::string& path = defaultIpcPath()) {
+        conn = connectIpc(path);
+        return conn.valid();
+    }
+
+    bool connected() const { return conn.valid(); }
+
+    bool query(const std::string& question, bool fast, const std::string& model, QueryResult& result,
+               Priority priority = Priority::Interactive) {
+        request.clear();
+        uint8_t op = fast ? DAEMON_OP_FAST : DAEMON_OP_ASK;
+        request += static_cast<char>(priority == Priority::Batch ? op | DAEMON_OP_BATCH : op);
+        request += static_cast<char>(model.size() & 0xFF);
+        request += static_cast<char>((model.size() >> 8) & 0xFF);
+        request += model;
+        request += question;
+        if (!roundTrip() || response.size() < DAEMON_QUERY_HEADER) {
+            return false;
+        }
+        uint8_t flags = static_cast<uint8_t>(response[1]);
+        result.cached = (flags & DAEMON_FLAG_CACHED) != 0;
+        result.coalesced = (flags & DAEMON_FLAG_COALESCED) != 0;
+        result.ms = ipcGetU32(response.data() + 2);
+        result.reply.evalCount = ipcGetU32(response.data() + 6);
+        result.similarity = ipcGetU32(response.data() + 10) / 1e6f;
+        result.reply.ok = response[0] == DAEMON_OK;
+        result.reply.done = result.reply.ok;
+        if (result.reply.ok) {
+            result.reply.text = std::make_shared<const std::string>(response.substr(DAEMON_QUERY_HEADER));
+        } else {
+            result.reply.error = response.substr(DAEMON_QUERY_HEADER);
+        }
+        return true;
+    }
+
+    bool cacheStats(CacheStats& st) {
+        request.assign(1, static_cast<char>(DAEMON_OP_CACHESTATS));
+        if (!roundTrip() || response.size() < DAEMON_STATS_SIZE) {
+            return false;
+        }
+        const char* p = response.data() + 1;
+        st.total = static_cast<int>(ipcGetU32(p));
+        st.valid = static_cast<int>(ipcGetU32(p + 4));
+        st.expired = static_cast<int>(ipcGetU32(p + 8));
+        st.compressed = static_cast<int>(ipcGetU32(p + 12));
+        st.totalAccess = static_cast<long long>(ipcGetU64(p + 16));
+        st.bytes = ipcGetU64(p + 24);
+        st.rawBytes = ipcGetU64(p + 32);
+        st.fileBytes = ipcGetU64(p + 40);
+        st.byteBudget = ipcGetU64(p + 48);
+        return true;
+    }
+
+    // Histogramas acumulados por el daemon desde que arrancó
+    bool metricsDump(bool prometheus, std::string& out) {
+        request.assign(1, static_cast<char>(DAEMON_OP_METRICS));
+        request += static_cast<char>(prometheus ? 1 : 0);
+        if (!roundTrip()) {
+            return false;
+        }
+        out = response.substr(1);
+        return true;
+    }
+};
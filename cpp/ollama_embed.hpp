@@ -0,0 +1,87 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include "ollama_cache.hpp"
+#include "ollama_hash.hpp"
+
+const std::string DEFAULT_EMBED_MODEL = "nomic-embed-text";
+const size_t EMBED_BATCH_SIZE = 64;        // Entradas por petición a /api/embed
+const uint32_t EMBED_CACHE_SIZE = 50000;   // Vectores máximos en el cache
+const uint64_t EMBED_CACHE_MAX_BYTES = 256ULL << 20; // ~85k vectores de 768 dimensiones
+const int EMBED_CACHE_EXPIRY = 30 * 24 * 3600; // Un embedding no cambia: 30 días
+
+// Archivo de vectores (little-endian): [magic 8][count u32][dim u32][count x dim float32]
+const char EMBED_FILE_MAGIC[8] = {'O', 'L', 'L', 'E', 'M', 'B', 'D', '1'};
+
+// Resultado de embed(): una fila de 'dim' floats por entrada, en memoria contigua
+struct Embeddings {
+    std::vector<float> data;
+    size_t count = 0;
+    size_t dim = 0;
+    size_t cached = 0;   // Filas servidas desde el cache
+    bool ok = false;
+    std::string error;
+
+    const float* row(size_t i) const { return data.data() + i * dim; }
+};
+
+// Modelo de embeddings (OLLAMA_EMBED_MODEL si está definido)
+inline std::string defaultEmbedModel() {
+    const char* env = std::getenv("OLLAMA_EMBED_MODEL");
+    if (env && *env) {
+        return env;
+    }
+    return DEFAULT_EMBED_MODEL;
+}
+
+// Cache de vectores separado del de respuestas (OLLAMA_EMBED_CACHE_FILE o ~/.ollama_embed_cache.bin)
+inline std::string defaultEmbedCachePath() {
+    const char* env = std::getenv("OLLAMA_EMBED_CACHE_FILE");
+    if (env && *env) {
+        return env;
+    }
+#ifdef _WIN32
+    const char* home = std::getenv("USERPROFILE");
+#else
+    const char* home = std::getenv("HOME");
+#endif
+    if (home && *home) {
+        return std::string(home) + "/.ollama_embed_cache.bin";
+    }
+    return "ollama_embed_cache.bin";
+}
+
+// Se abre en el primer embed(): los demás comandos no crean el archivo
+inline PersistentCache& embedCache() {
+    static PersistentCache cache(defaultEmbedCachePath(), EMBED_CACHE_SIZE, EMBED_CACHE_MAX_BYTES);
+    return cache;
+}
+
+// Clave por contenido: mismo modelo + mismo texto = mismo vector
+inline CacheKey embedKey(const std::string& model, const std::string& input) {
+    return KeyHasher().add("embed").add(model).add(input).finish();
+}
+
+inline bool saveEmbeddings(const std::string& path, const Embeddings& e) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        return false;
+    }
+    unsigned char header[16];
+    std::memcpy(header, EMBED_FILE_MAGIC, sizeof(EMBED_FILE_MAGIC));
+    uint32_t fields[2] = {static_cast<uint32_t>(e.count), static_cast<uint32_t>(e.dim)};
+    for (int f = 0; f < 2; ++f) {
+        for (int b = 0; b < 4; ++b) {
+            header[8 + f * 4 + b] = static_cast<unsigned char>(fields[f] >> (8 * b));
+        }
+    }
+    out.write(reinterpret_cast<const char*>(header), sizeof(header));
+    // Los floats se escriben tal cual: todas las plataformas soportadas son little-endian
+    out.write(reinterpret_cast<const char*>(e.data.data()), e.data.size() * sizeof(float));
+    return static_cast<bool>(out);
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <cstring>
+#include <openssl/evp.h>
+
+const size_t CACHE_KEY_SIZE = 16; // 128 bits (SHA-256 truncado)
+
+// Clave binaria de ancho fijo, guardada tal cual en el índice del cache
+struct CacheKey {
+    unsigned char bytes[CACHE_KEY_SIZE];
+
+    bool operator==(const CacheKey& other) const {
+        return std::memcmp(bytes, other.bytes, CACHE_KEY_SIZE) == 0;
+    }
+
+    bool operator!=(const CacheKey& other) const { return !(*this == other); }
+
+    // Primeros 64 bits: ya uniformes, sirven directamente como hash de tabla
+    uint64_t prefix() const {
+        uint64_t v;
+        std::memcpy(&v, bytes, sizeof(v));
+        return v;
+    }
+
+    std::string hex() const {
+        static const char digits[] = "0123456789abcdef";
+        std::string out(CACHE_KEY_SIZE * 2, '0');
+        for (size_t i = 0; i < CACHE_KEY_SIZE; ++i) {
+            out[2 * i] = digits[bytes[i] >> 4];
+            out[2 * i + 1] = digits[bytes[i] & 0x0F];
+        }
+        return out;
+    }
+};
+
+// Hash para unordered_map: el prefijo del digest ya está distribuido uniformemente
+struct CacheKeyHash {
+    size_t operator()(const CacheKey& key) const { return static_cast<size_t>(key.prefix()); }
+};
+
+// Hash incremental: cada campo entra como longitud (uint32 LE) + bytes, sin concatenar strings.
+// Reutiliza un EVP_MD_CTX por hilo; usar un solo KeyHasher a la vez en cada hilo.
+class KeyHasher {
+private:
+    EVP_MD_CTX* ctx;
+
+    static EVP_MD_CTX* threadContext() {
+        struct Holder {
+            EVP_MD_CTX* ctx = EVP_MD_CTX_new();
+            ~Holder() { EVP_MD_CTX_free(ctx); }
+        };
+        thread_local Holder holder;
+        return holder.ctx;
+    }
+
+public:
+    KeyHasher() : ctx(threadContext()) {
+        EVP_DigestInit_ex(ctx, EVP_sha256(), nullptr);
+    }
+
+    KeyHasher& add(const char* data, size_t len) {
+        uint32_t n = static_cast<uint32_t>(len);
+        unsigned char le[4] = {
+            static_cast<unsigned char>(n), static_cast<unsigned char>(n >> 8),
+            static_cast<unsigned char>(n >> 16), static_cast<unsigned char>(n >> 24)
+        };
+        EVP_DigestUpdate(ctx, le, sizeof(le));
+        EVP_DigestUpdate(ctx, data, len);
+        return *this;
+    }
+
+    KeyHasher& add(const std::string& field) { return add(field.data(), field.size()); }
+
+    CacheKey finish() {
+        unsigned char full[EVP_MAX_MD_SIZE];
+        unsigned int len = 0;
+        EVP_DigestFinal_ex(ctx, full, &len);
+        CacheKey key;
+        std::memcpy(key.bytes, full, CACHE_KEY_SIZE);
+        return key;
+    }
+};
+
+// Huella canónica de una petición /api/generate: todo lo que cambia la respuesta.
+// 'options' debe venir en forma canónica (claves ordenadas, sin espacios).
+inline CacheKey requestFingerprint(const std::string& model, const std::string& system,
+                                   const std::string& prompt, const std::string& options) {
+    return KeyHasher().add(model).add(system).add(prompt).add(options).finish();
+}
@@ -0,0 +1,288 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <cstring>
+#include <functional>
+#include <chrono>
+#include <curl/curl.h>
+
+const size_t HTTP_RESPONSE_RESERVE = 16 * 1024; // Reserva inicial para la respuesta
+
+// Callback para CURL
+inline size_t WriteCallback(void* contents, size_t size, size_t nmemb, std::string* userp) {
+    userp->append((char*)contents, size * nmemb);
+    return size * nmemb;
+}
+
+// Lector de líneas NDJSON: solo guarda la línea incompleta, nunca el cuerpo entero
+struct LineStream {
+    std::string pending;
+    std::function<void(const char*, size_t)> onLine;
+};
+
+// Callback para CURL en streaming: entrega cada línea completa en cuanto llega
+inline size_t StreamCallback(void* contents, size_t size, size_t nmemb, LineStream* ls) {
+    const char* p = static_cast<const char*>(contents);
+    size_t n = size * nmemb;
+    size_t start = 0;
+    const char* nl;
+    while ((nl = static_cast<const char*>(std::memchr(p + start, '\n', n - start))) != nullptr) {
+        size_t len = nl - (p + start);
+        if (ls->pending.empty()) {
+            ls->onLine(p + start, len);
+        } else {
+            ls->pending.append(p + start, len);
+            ls->onLine(ls->pending.data(), ls->pending.size());
+            ls->pending.clear();
+        }
+        start += len + 1;
+    }
+    ls->pending.append(p + start, n - start);
+    return n;
+}
+
+// Pool de conexiones CURL: handles reutilizables + CURLSH compartido (DNS y conexiones)
+class CurlPool {
+private:
+    CURLSH* share;
+    struct curl_slist* headers;
+    std::vector<CURL*> idle;
+    std::mutex mtx;
+    std::mutex shareLocks[CURL_LOCK_DATA_LAST];
+
+    static void lockShare(CURL*, curl_lock_data data, curl_lock_access, void* userp) {
+        static_cast<CurlPool*>(userp)->shareLocks[data].lock();
+    }
+
+    static void unlockShare(CURL*, curl_lock_data data, void* userp) {
+        static_cast<CurlPool*>(userp)->shareLocks[data].unlock();
+    }
+
+public:
+    CurlPool() {
+        curl_global_init(CURL_GLOBAL_DEFAULT);
+        share = curl_share_init();
+        curl_share_setopt(share, CURLSHOPT_LOCKFUNC, lockShare);
+        curl_share_setopt(share, CURLSHOPT_UNLOCKFUNC, unlockShare);
+        curl_share_setopt(share, CURLSHOPT_USERDATA, this);
+        curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+        curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+        headers = curl_slist_append(NULL, "Content-Type: application/json");
+    }
+
+    CurlPool(const CurlPool&) = delete;
+    CurlPool& operator=(const CurlPool&) = delete;
+
+    ~CurlPool() {
+        for (CURL* curl : idle) {
+            curl_easy_cleanup(curl);
+        }
+        curl_share_cleanup(share);
+        curl_slist_free_all(headers);
+        curl_global_cleanup();
+    }
+
+    // Obtener handle (reutilizado si hay alguno libre)
+    CURL* acquire() {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            if (!idle.empty()) {
+                CURL* curl = idle.back();
+                idle.pop_back();
+                return curl;
+            }
+        }
+
+        CURL* curl = curl_easy_init();
+        if (!curl) {
+            return nullptr;
+        }
+        curl_easy_setopt(curl, CURLOPT_SHARE, share);
+        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+        curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+        curl_easy_setopt(curl, CURLOPT_TCP_KEEPIDLE, 60L);
+        curl_easy_setopt(curl, CURLOPT_TCP_KEEPINTVL, 30L);
+        curl_easy_setopt(curl, CURLOPT_TCP_NODELAY, 1L);
+        curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
+        return curl;
+    }
+
+    // Devolver handle al pool; la conexión queda abierta para la siguiente llamada
+    void release(CURL* curl) {
+        std::lock_guard<std::mutex> lock(mtx);
+        idle.push_back(curl);
+    }
+};
+
+// Fases de una petición según libcurl, en microsegundos
+struct HttpTiming {
+    long long connectUs = 0;   // DNS + TCP (0 si se reutilizó la conexión)
+    long long ttfbUs = 0;      // Desde enviar la petición hasta el primer byte de respuesta
+    long long transferUs = 0;  // Desde el primer byte hasta el final
+};
+
+inline void readTiming(CURL* curl, HttpTiming* timing) {
+    if (!timing) {
+        return;
+    }
+    curl_off_t connect = 0, pretransfer = 0, start = 0, total = 0;
+    curl_easy_getinfo(curl, CURLINFO_CONNECT_TIME_T, &connect);
+    curl_easy_getinfo(curl, CURLINFO_PRETRANSFER_TIME_T, &pretransfer);
+    curl_easy_getinfo(curl, CURLINFO_STARTTRANSFER_TIME_T, &start);
+    curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME_T, &total);
+    timing->connectUs = connect;
+    timing->ttfbUs = start > pretransfer ? start - pretransfer : 0;
+    timing->transferUs = total > start ? total - start : 0;
+}
+
+// Configurar un handle para GET (body vacío) o POST JSON con la respuesta en 'out'
+inline void prepareRequest(CURL* curl, const std::string& url, const std::string& body, long timeout,
+                           std::string& out) {
+    out.clear();
+    out.reserve(HTTP_RESPONSE_RESERVE);
+
+    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+    if (body.empty()) {
+        curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
+    } else {
+        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, body.c_str());
+        curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, static_cast<long>(body.size()));
+    }
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &out);
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT, timeout);
+}
+
+// Petición HTTP en proceso (GET si body está vacío, POST JSON si no).
+// La respuesta se escribe directamente en 'out', reservado de antemano.
+inline CURLcode httpRequest(CurlPool& pool, const std::string& url, const std::string& body,
+                            long timeout, std::string& out, HttpTiming* timing = nullptr) {
+    CURL* curl = pool.acquire();
+    if (!curl) {
+        return CURLE_FAILED_INIT;
+    }
+
+    prepareRequest(curl, url, body, timeout, out);
+    CURLcode res = curl_easy_perform(curl);
+    readTiming(curl, timing);
+
+    pool.release(curl);
+    return res;
+}
+
+// Petición con copia de respaldo (hedging), en el hilo que llama y sin hilos extra: si la
+// primera no terminó en 'hedgeAfterMs' (o falló antes), se envía la misma a 'backupUrl' y gana
+// la primera respuesta correcta. La otra se quita del multi: su conexión se cierra y Ollama deja
+// de generar. 'onHedge' se llama al enviar la copia; 'winner' = 0 primera, 1 copia, -1 ninguna.
+inline CURLcode httpHedged(CurlPool& pool, const std::string& primaryUrl, const std::string& backupUrl,
+                           const std::string& body, long timeout, long long hedgeAfterMs,
+                           const std::function<void()>& onHedge, std::string& out, HttpTiming* timing,
+                           int& winner) {
+    winner = -1;
+    CURLM* multi = curl_multi_init();
+    CURL* handles[2] = {pool.acquire(), nullptr};
+    if (!multi || !handles[0]) {
+        if (handles[0]) {
+            pool.release(handles[0]);
+        }
+        if (multi) {
+            curl_multi_cleanup(multi);
+        }
+        return CURLE_FAILED_INIT;
+    }
+    std::string backupOut;
+    CURLcode results[2] = {CURLE_OK, CURLE_OK};
+    bool done[2] = {false, false};
+    bool backupTried = false;
+    prepareRequest(handles[0], primaryUrl, body, timeout, out);
+    curl_multi_add_handle(multi, handles[0]);
+    auto hedgeAt = std::chrono::steady_clock::now() + std::chrono::milliseconds(hedgeAfterMs);
+
+    while (true) {
+        int running = 0;
+        curl_multi_perform(multi, &running);
+        int queued = 0;
+        while (CURLMsg* msg = curl_multi_info_read(multi, &queued)) {
+            if (msg->msg != CURLMSG_DONE) {
+                continue;
+            }
+            int i = msg->easy_handle == handles[0] ? 0 : 1;
+            done[i] = true;
+            results[i] = msg->data.result;
+            if (results[i] == CURLE_OK && winner < 0) {
+                winner = i;
+            }
+        }
+        if (winner >= 0) {
+            break;
+        }
+        auto now = std::chrono::steady_clock::now();
+        if (!backupTried && (done[0] || now >= hedgeAt)) {
+            backupTried = true;
+            handles[1] = pool.acquire();
+            if (handles[1]) {
+                prepareRequest(handles[1], backupUrl, body, timeout, backupOut);
+                curl_multi_add_handle(multi, handles[1]);
+                if (onHedge) {
+                    onHedge();
+                }
+                continue;
+            }
+        }
+        if (done[0] && (!handles[1] || done[1])) {
+            break; // Todas terminaron con error
+        }
+        long long waitMs = 100;
+        if (!backupTried) {
+            waitMs = std::chrono::duration_cast<std::chrono::milliseconds>(hedgeAt - now).count() + 1;
+            waitMs = waitMs < 1 ? 1 : (waitMs > 100 ? 100 : waitMs);
+        }
+        curl_multi_poll(multi, nullptr, 0, static_cast<int>(waitMs), nullptr);
+    }
+
+    readTiming(handles[winner >= 0 ? winner : 0], timing);
+    for (CURL* curl : handles) {
+        if (curl) {
+            curl_multi_remove_handle(multi, curl);
+            pool.release(curl);
+        }
+    }
+    curl_multi_cleanup(multi);
+    if (winner == 1) {
+        out.swap(backupOut);
+    }
+    return winner >= 0 ? CURLE_OK : results[0];
+}
+
+// Petición POST en streaming: 'onLine' recibe cada línea NDJSON sin acumular el cuerpo
+inline CURLcode httpStream(CurlPool& pool, const std::string& url, const std::string& body,
+                           long timeout, const std::function<void(const char*, size_t)>& onLine,
+                           HttpTiming* timing = nullptr) {
+    CURL* curl = pool.acquire();
+    if (!curl) {
+        return CURLE_FAILED_INIT;
+    }
+
+    LineStream ls;
+    ls.onLine = onLine;
+
+    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, body.c_str());
+    curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, static_cast<long>(body.size()));
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, StreamCallback);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &ls);
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT, timeout);
+
+    CURLcode res = curl_easy_perform(curl);
+    readTiming(curl, timing);
+
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
+    pool.release(curl);
+
+    if (res == CURLE_OK && !ls.pending.empty()) {
+        onLine(ls.pending.data(), ls.pending.size());
+    }
+    return res;
+}
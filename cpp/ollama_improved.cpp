@@ -6,64 +6,57 @@
 #include <future>
 #include <iomanip>
 #include <sstream>
-#include <fstream>
 #include <vector>
 #include <cstdlib>
+#include "ollama_cache.hpp"
+#include "ollama_http.hpp"
+#include "ollama_latency.hpp"
+#include "ollama_pool.hpp"
+#include "ollama_reply.hpp"
+#include "ollama_request.hpp"
 
 // Configuración por defecto
 const std::string DEFAULT_MODEL = "codellama:7b-code-q4_K_M";
 const std::string DEFAULT_ENDPOINT = "http://localhost:11434";
 const int DEFAULT_TIMEOUT = 30;
 const int CACHE_EXPIRY = 3600; // 1 hora
+const int MAX_CACHE_SIZE = 1000; // Máximo elementos en cache
 
-// Estructura para cache
-struct CacheEntry {
-    std::string response;
-    std::chrono::system_clock::time_point expiry;
-};
+// Cache global persistente (archivo mapeado en memoria)
+PersistentCache ollamaCache(defaultCachePath(), MAX_CACHE_SIZE, defaultCacheMaxBytes());
 
-// Cache global
-std::map<std::string, CacheEntry> ollamaCache;
+// Opciones de muestreo por modo (JSON canónico: claves ordenadas, sin espacios)
+const std::string ASK_OPTIONS = "{\"num_predict\":100,\"temperature\":0.7}";
+const std::string FAST_OPTIONS = "{\"num_predict\":20,\"temperature\":0.1}";
 
-// Función simple para generar hash
-std::string generateHash(const std::string& prompt, const std::string& model) {
-    std::string content = prompt + "|" + model;
-    std::hash<std::string> hasher;
-    return std::to_string(hasher(content));
+// Clave binaria de 128 bits (modelo + prompt + opciones de muestreo)
+CacheKey generateHash(const std::string& prompt, const std::string& model, const std::string& options) {
+    return requestFingerprint(model, "", prompt, options);
 }
 
-// Función para hacer HTTP request usando curl con archivo temporal
-std::string makeHttpRequest(const std::string& url, const std::string& data) {
-    // Crear archivo temporal para el JSON
-    std::string tempFile = "temp_request.json";
-    std::ofstream file(tempFile);
-    if (file.is_open()) {
-        file << data;
-        file.close();
-    } else {
-        return "";
-    }
-    
-    // Comando curl usando archivo
-    std::string command = "curl.exe -s -X POST -H \"Content-Type: application/json\" -d @" + tempFile + " \"" + url + "\"";
-    
-    FILE* pipe = _popen(command.c_str(), "r");
-    if (!pipe) {
-        std::remove(tempFile.c_str());
-        return "";
-    }
-    
+// Pool de conexiones HTTP compartido por todas las peticiones
+CurlPool httpPool;
+
+// Latencias por modelo y clase de petición: de ellas sale el timeout de cada generación
+LatencyTracker latency;
+
+// Función para hacer HTTP request en proceso con libcurl.
+// Con 'key' el timeout es el adaptativo de esa clase y la duración se aprende.
+std::string makeHttpRequest(const std::string& url, const std::string& data, long timeout,
+                            const std::string& key = "") {
     std::string result;
-    char buffer[128];
-    while (fgets(buffer, sizeof(buffer), pipe) != NULL) {
-        result += buffer;
+    CURLcode res = key.empty() ? httpRequest(httpPool, url, data, timeout, result)
+                               : timedRequest(httpPool, latency, key, url, data, timeout, result);
+    return res == CURLE_OK ? result : "";
+}
+
+// Quedarse con el texto de /api/generate: es lo que se muestra y lo que se guarda en cache
+std::string generateText(const std::string& body) {
+    if (body.empty()) {
+        return "";
     }
-    _pclose(pipe);
-    
-    // Limpiar archivo temporal
-    std::remove(tempFile.c_str());
-    
-    return result;
+    GenerateReply reply = scanGenerateReply(body);
+    return reply.ok ? std::string(reply.response()) : "";
 }
 
 // Cliente principal de Ollama
@@ -72,53 +65,74 @@ private:
     std::string model;
     std::string endpoint;
     int timeout;
+    size_t maxInFlight;
+    std::string generateUrl;      // endpoint + /api/generate
+    RequestTemplate askTemplate;  // Cuerpos precompilados por modo
+    RequestTemplate fastTemplate;
+    std::string askKey;           // Clases de latencia por modo
+    std::string fastKey;
+    std::mutex workersMutex;
+    std::unique_ptr<ThreadPool> workers; // Último miembro: se detiene antes que el resto
+    
+    // Pool de hilos acotado para askAsync (se crea en el primer uso)
+    ThreadPool& executor() {
+        std::lock_guard<std::mutex> lock(workersMutex);
+        if (!workers) {
+            workers.reset(new ThreadPool(maxInFlight));
+        }
+        return *workers;
+    }
+    
+    // Partes constantes de cada petición: se rehacen solo al cambiar de modelo
+    void compileRequests() {
+        generateUrl = endpoint + "/api/generate";
+        askTemplate = RequestTemplate(model, ASK_OPTIONS, false);
+        fastTemplate = RequestTemplate(model, FAST_OPTIONS, false);
+        askKey = latencyKey(model, "ask");
+        fastKey = latencyKey(model, "fast");
+    }
     
 public:
     OllamaClient(const std::string& m = DEFAULT_MODEL, 
                  const std::string& ep = DEFAULT_ENDPOINT, 
-                 int t = DEFAULT_TIMEOUT) 
-        : model(m), endpoint(ep), timeout(t) {
+                 int t = defaultTimeout(DEFAULT_TIMEOUT),
+                 size_t parallel = defaultParallelism()) 
+        : model(m), endpoint(ep), timeout(t), maxInFlight(parallel) {
+        compileRequests();
     }
     
     // Llamada síncrona con cache
     std::string ask(const std::string& question, bool useCache = true) {
         std::cout << "🤖 Ollama: " << question << std::endl << std::endl;
         
+        CacheKey hash = generateHash(question, model, ASK_OPTIONS);
+        
         // Verificar cache
         if (useCache) {
-            std::string hash = generateHash(question, model);
-            auto it = ollamaCache.find(hash);
-            if (it != ollamaCache.end()) {
-                auto now = std::chrono::system_clock::now();
-                if (now < it->second.expiry) {
-                    std::cout << "⚡ Respuesta desde cache:" << std::endl;
-                    std::cout << it->second.response << std::endl;
-                    std::cout << std::endl << "⏱️  Cache hit - tiempo instantáneo" << std::endl;
-                    return it->second.response;
-                } else {
-                    ollamaCache.erase(it);
-                }
+            std::string cached;
+            if (ollamaCache.get(hash, cached)) {
+                std::cout << "⚡ Respuesta desde cache:" << std::endl;
+                std::cout << cached << std::endl;
+                std::cout << std::endl << "⏱️  Cache hit - tiempo instantáneo" << std::endl;
+                return cached;
             }
         }
         
-        // Preparar datos JSON
-        std::string jsonData = "{\"model\":\"" + model + "\",\"prompt\":\"" + question + "\",\"stream\":false,\"options\":{\"temperature\":0.7,\"num_predict\":100}}";
+        // Cuerpo desde la plantilla: solo se escapa la pregunta
+        const std::string& jsonData = askTemplate.render(question);
         
         auto start = std::chrono::high_resolution_clock::now();
         
         // Realizar llamada HTTP
-        std::string response = makeHttpRequest(endpoint + "/api/generate", jsonData);
+        std::string response = generateText(
+            makeHttpRequest(generateUrl, jsonData, timeout, askKey));
         
         auto end = std::chrono::high_resolution_clock::now();
         auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
         
         // Guardar en cache
         if (useCache && !response.empty()) {
-            std::string hash = generateHash(question, model);
-            CacheEntry entry;
-            entry.response = response;
-            entry.expiry = std::chrono::system_clock::now() + std::chrono::seconds(CACHE_EXPIRY);
-            ollamaCache[hash] = entry;
+            ollamaCache.put(hash, response, CACHE_EXPIRY);
         }
         
         // Mostrar respuesta
@@ -137,9 +151,10 @@ public:
     std::future<std::string> askAsync(const std::string& question) {
         std::cout << "🔄 Iniciando pregunta asíncrona..." << std::endl;
         
-        return std::async(std::launch::async, [this, question]() {
-            std::string jsonData = "{\"model\":\"" + model + "\",\"prompt\":\"" + question + "\",\"stream\":false,\"options\":{\"temperature\":0.7,\"num_predict\":100}}";
-            return makeHttpRequest(endpoint + "/api/generate", jsonData);
+        return executor().submit([this, question]() {
+            const std::string& jsonData = askTemplate.render(question);
+            return generateText(
+                makeHttpRequest(generateUrl, jsonData, timeout, askKey));
         });
     }
     
@@ -147,40 +162,33 @@ public:
     std::string askFast(const std::string& question, bool useCache = true) {
         std::cout << "⚡ Pregunta rápida: " << question << std::endl << std::endl;
         
+        CacheKey hash = generateHash(question, model, FAST_OPTIONS);
+        
         // Verificar cache
         if (useCache) {
-            std::string hash = generateHash(question, model);
-            auto it = ollamaCache.find(hash);
-            if (it != ollamaCache.end()) {
-                auto now = std::chrono::system_clock::now();
-                if (now < it->second.expiry) {
-                    std::cout << "⚡ Respuesta rápida desde cache:" << std::endl;
-                    std::cout << it->second.response << std::endl;
-                    std::cout << std::endl << "⚡ Cache hit - tiempo instantáneo" << std::endl;
-                    return it->second.response;
-                } else {
-                    ollamaCache.erase(it);
-                }
+            std::string cached;
+            if (ollamaCache.get(hash, cached)) {
+                std::cout << "⚡ Respuesta rápida desde cache:" << std::endl;
+                std::cout << cached << std::endl;
+                std::cout << std::endl << "⚡ Cache hit - tiempo instantáneo" << std::endl;
+                return cached;
             }
         }
         
-        // Preparar datos para pregunta rápida
-        std::string jsonData = "{\"model\":\"" + model + "\",\"prompt\":\"" + question + "\",\"stream\":false,\"options\":{\"temperature\":0.1,\"num_predict\":20}}";
+        // Cuerpo desde la plantilla rápida
+        const std::string& jsonData = fastTemplate.render(question);
         
         auto start = std::chrono::high_resolution_clock::now();
         
-        std::string response = makeHttpRequest(endpoint + "/api/generate", jsonData);
+        std::string response = generateText(
+            makeHttpRequest(generateUrl, jsonData, timeout, fastKey));
         
         auto end = std::chrono::high_resolution_clock::now();
         auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
         
         // Guardar en cache
         if (useCache && !response.empty()) {
-            std::string hash = generateHash(question, model);
-            CacheEntry entry;
-            entry.response = response;
-            entry.expiry = std::chrono::system_clock::now() + std::chrono::seconds(CACHE_EXPIRY);
-            ollamaCache[hash] = entry;
+            ollamaCache.put(hash, response, CACHE_EXPIRY);
         }
         
         if (!response.empty()) {
@@ -194,9 +202,17 @@ public:
         return response;
     }
     
+    // Límite de peticiones asíncronas en vuelo (usar antes de la primera askAsync)
+    void setMaxInFlight(size_t n) {
+        std::lock_guard<std::mutex> lock(workersMutex);
+        maxInFlight = n;
+        workers.reset();
+    }
+    
     // Cambiar modelo
     void setModel(const std::string& newModel) {
         model = newModel;
+        compileRequests();
         std::cout << "🤖 Modelo cambiado a: " << model << std::endl;
     }
     
@@ -208,7 +224,7 @@ public:
         std::cout << "   Cache: " << ollamaCache.size() << " elementos" << std::endl;
         
         // Verificar conexión
-        std::string response = makeHttpRequest(endpoint + "/api/tags", "{}");
+        std::string response = makeHttpRequest(endpoint + "/api/tags", "", STATUS_TIMEOUT);
         
         if (!response.empty()) {
             std::cout << "   ✅ Servidor conectado" << std::endl;
@@ -225,23 +241,13 @@ public:
     
     // Estadísticas de cache
     void cacheStats() {
-        int total = ollamaCache.size();
-        int valid = 0;
-        int expired = 0;
-        
-        auto now = std::chrono::system_clock::now();
-        for (const auto& entry : ollamaCache) {
-            if (now < entry.second.expiry) {
-                valid++;
-            } else {
-                expired++;
-            }
-        }
+        CacheStats st = ollamaCache.stats();
         
         std::cout << "📊 Estadísticas de Cache:" << std::endl;
-        std::cout << "   Total: " << total << " elementos" << std::endl;
-        std::cout << "   Válidos: " << valid << " elementos" << std::endl;
-        std::cout << "   Expirados: " << expired << " elementos" << std::endl;
+        std::cout << "   Total: " << st.total << " elementos" << std::endl;
+        std::cout << "   Válidos: " << st.valid << " elementos" << std::endl;
+        std::cout << "   Expirados: " << st.expired << " elementos" << std::endl;
+        std::cout << "   Datos: " << st.bytes << " bytes (" << st.rawBytes << " sin comprimir)" << std::endl;
     }
 };
 
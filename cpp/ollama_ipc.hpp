@@ -0,0 +1,422 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <condition_variable>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <cstdint>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN // Sin winsock.h: ollama_mock.hpp incluye winsock2.h
+#endif
+#include <windows.h>
+typedef HANDLE IpcHandle;
+const IpcHandle IPC_INVALID_HANDLE = INVALID_HANDLE_VALUE;
+#else
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cerrno>
+typedef int IpcHandle;
+const IpcHandle IPC_INVALID_HANDLE = -1;
+#endif
+
+// Transporte local del daemon (serve): socket Unix en POSIX, named pipe en Windows.
+// Cada mensaje es una trama [longitud u32 little-endian][cuerpo]; el primer byte del cuerpo
+// es la operación (petición) o el estado (respuesta).
+const uint32_t IPC_MAX_FRAME = 16 * 1024 * 1024;
+
+// Ruta del canal: OLLAMA_IPC_PATH, o por usuario en XDG_RUNTIME_DIR / /tmp
+inline std::string defaultIpcPath() {
+    const char* env = std::getenv("OLLAMA_IPC_PATH");
+    if (env && *env) {
+        return env;
+    }
+#ifdef _WIN32
+    return "\\\\.\\pipe\\ollama_client";
+#else
+    const char* runtime = std::getenv("XDG_RUNTIME_DIR");
+    if (runtime && *runtime) {
+        return std::string(runtime) + "/ollama_client.sock";
+    }
+    return "/tmp/ollama_client-" + std::to_string(getuid()) + ".sock";
+#endif
+}
+
+// Enteros little-endian para los campos de las tramas
+inline void ipcPutU32(std::string& out, uint32_t v) {
+    for (int b = 0; b < 4; ++b) {
+        out += static_cast<char>((v >> (8 * b)) & 0xFF);
+    }
+}
+
+inline void ipcPutU64(std::string& out, uint64_t v) {
+    for (int b = 0; b < 8; ++b) {
+        out += static_cast<char>((v >> (8 * b)) & 0xFF);
+    }
+}
+
+inline uint32_t ipcGetU32(const char* p) {
+    uint32_t v = 0;
+    for (int b = 0; b < 4; ++b) {
+        v |= static_cast<uint32_t>(static_cast<unsigned char>(p[b])) << (8 * b);
+    }
+    return v;
+}
+
+inline uint64_t ipcGetU64(const char* p) {
+    uint64_t v = 0;
+    for (int b = 0; b < 8; ++b) {
+        v |= static_cast<uint64_t>(static_cast<unsigned char>(p[b])) << (8 * b);
+    }
+    return v;
+}
+
+// Una conexión (extremo cliente o servidor); se cierra al destruirse
+class IpcConnection {
+private:
+    IpcHandle h = IPC_INVALID_HANDLE;
+#ifdef _WIN32
+    bool serverSide = false;
+#endif
+
+    bool readExact(char* buf, size_t len) {
+        while (len > 0) {
+#ifdef _WIN32
+            DWORD n = 0;
+            if (!ReadFile(h, buf, static_cast<DWORD>(std::min<size_t>(len, 1 << 20)), &n, nullptr) || n == 0) {
+                return false;
+            }
+#else
+            ssize_t n = ::recv(h, buf, len, 0);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                return false;
+            }
+#endif
+            buf += n;
+            len -= static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+    bool writeAll(const char* buf, size_t len) {
+        while (len > 0) {
+#ifdef _WIN32
+            DWORD n = 0;
+            if (!WriteFile(h, buf, static_cast<DWORD>(std::min<size_t>(len, 1 << 20)), &n, nullptr)) {
+                return false;
+            }
+#else
+#ifdef MSG_NOSIGNAL
+            ssize_t n = ::send(h, buf, len, MSG_NOSIGNAL); // Un cliente que se va no debe tumbar el daemon
+#else
+            ssize_t n = ::send(h, buf, len, 0);
+#endif
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                return false;
+            }
+#endif
+            buf += n;
+            len -= static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+public:
+    IpcConnection() = default;
+#ifdef _WIN32
+    IpcConnection(IpcHandle handle, bool server) : h(handle), serverSide(server) {}
+#else
+    explicit IpcConnection(IpcHandle handle) : h(handle) {}
+#endif
+
+    IpcConnection(IpcConnection&& other) noexcept : h(other.h) {
+#ifdef _WIN32
+        serverSide = other.serverSide;
+#endif
+        other.h = IPC_INVALID_HANDLE;
+    }
+
+    IpcConnection& operator=(IpcConnection&& other) noexcept {
+        if (this != &other) {
+            close();
+            h = other.h;
+#ifdef _WIN32
+            serverSide = other.serverSide;
+#endif
+            other.h = IPC_INVALID_HANDLE;
+        }
+        return *this;
+    }
+
+    IpcConnection(const IpcConnection&) = delete;
+    IpcConnection& operator=(const IpcConnection&) = delete;
+
+    ~IpcConnection() { close(); }
+
+    bool valid() const { return h != IPC_INVALID_HANDLE; }
+
+    void close() {
+        if (h == IPC_INVALID_HANDLE) {
+            return;
+        }
+#ifdef _WIN32
+        if (serverSide) {
+            FlushFileBuffers(h);
+            DisconnectNamedPipe(h);
+        }
+        CloseHandle(h);
+#else
+        ::close(h);
+#endif
+        h = IPC_INVALID_HANDLE;
+    }
+
+    // Cortar lecturas bloqueadas desde otro hilo (parada del daemon)
+    void interrupt() {
+#ifdef _WIN32
+        CancelIoEx(h, nullptr);
+#else
+        ::shutdown(h, SHUT_RDWR);
+#endif
+    }
+
+    // Cabecera y cuerpo en una sola escritura
+    bool writeFrame(const std::string& body) {
+        std::string frame;
+        frame.reserve(4 + body.size());
+        ipcPutU32(frame, static_cast<uint32_t>(body.size()));
+        frame += body;
+        return writeAll(frame.data(), frame.size());
+    }
+
+    // false si el otro extremo cerró o la trama supera IPC_MAX_FRAME
+    bool readFrame(std::string& body) {
+        char len[4];
+        if (!readExact(len, sizeof(len))) {
+            return false;
+        }
+        uint32_t n = ipcGetU32(len);
+        if (n > IPC_MAX_FRAME) {
+            return false;
+        }
+        body.resize(n);
+        return n == 0 || readExact(&body[0], n);
+    }
+};
+
+// Conectar con el daemon; conexión no válida si no hay nadie escuchando
+inline IpcConnection connectIpc(const std::string& path) {
+#ifdef _WIN32
+    for (int attempt = 0; attempt < 2; ++attempt) {
+        HANDLE h = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, OPEN_EXISTING, 0, nullptr);
+        if (h != INVALID_HANDLE_VALUE) {
+            return IpcConnection(h, false);
+        }
+        // Todas las instancias ocupadas: esperar un poco a que el daemon cree otra
+        if (GetLastError() != ERROR_PIPE_BUSY || !WaitNamedPipeA(path.c_str(), 100)) {
+            break;
+        }
+    }
+    return IpcConnection();
+#else
+    sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    if (path.size() >= sizeof(addr.sun_path)) {
+        return IpcConnection();
+    }
+    addr.sun_family = AF_UNIX;
+    std::memcpy(addr.sun_path, path.c_str(), path.size());
+    int s = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (s < 0) {
+        return IpcConnection();
+    }
+#ifdef SO_NOSIGPIPE
+    int one = 1;
+    setsockopt(s, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+    if (::connect(s, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        ::close(s);
+        return IpcConnection();
+    }
+    return IpcConnection(s);
+#endif
+}
+
+// Servidor de tramas: un hilo por conexión; 'handler' recibe el cuerpo de la petición y
+// rellena el de la respuesta. Varias peticiones por conexión, en orden.
+class IpcServer {
+public:
+    typedef std::function<void(const std::string& request, std::string& response)> Handler;
+
+private:
+    Handler handler;
+    std::string path;
+    std::atomic<bool> running{false};
+    std::atomic<unsigned long long> served{0};
+    std::thread acceptThread;
+    std::mutex connMutex;
+    std::condition_variable connDone;
+    std::vector<IpcConnection*> connections;
+#ifdef _WIN32
+    HANDLE pending = INVALID_HANDLE_VALUE;
+#else
+    int listener = -1;
+#endif
+
+    void serveConnection(IpcConnection* conn) {
+        std::string request;
+        std::string response;
+        while (running && conn->readFrame(request)) {
+            response.clear();
+            handler(request, response);
+            served++;
+            if (!conn->writeFrame(response)) {
+                break;
+            }
+        }
+        // Notificar con el lock tomado: stop() no puede volver antes de que terminemos
+        std::lock_guard<std::mutex> lock(connMutex);
+        connections.erase(std::remove(connections.begin(), connections.end(), conn), connections.end());
+        delete conn;
+        connDone.notify_all();
+    }
+
+    void track(IpcConnection* conn) {
+        std::lock_guard<std::mutex> lock(connMutex);
+        if (!running) {
+            delete conn;
+            return;
+        }
+        connections.push_back(conn);
+        std::thread([this, conn] { serveConnection(conn); }).detach();
+    }
+
+#ifdef _WIN32
+    HANDLE createInstance(bool first) {
+        DWORD mode = PIPE_ACCESS_DUPLEX | (first ? FILE_FLAG_FIRST_PIPE_INSTANCE : 0);
+        return CreateNamedPipeA(path.c_str(), mode, PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT,
+                                PIPE_UNLIMITED_INSTANCES, 64 * 1024, 64 * 1024, 0, nullptr);
+    }
+
+    void acceptLoop() {
+        while (running) {
+            BOOL ok = ConnectNamedPipe(pending, nullptr) || GetLastError() == ERROR_PIPE_CONNECTED;
+            HANDLE connected = pending;
+            pending = createInstance(false);
+            if (!running || !ok) {
+                CloseHandle(connected);
+                continue;
+            }
+            track(new IpcConnection(connected, true));
+        }
+    }
+#else
+    void acceptLoop() {
+        while (running) {
+            int s = ::accept(listener, nullptr, nullptr);
+            if (s < 0) {
+                continue;
+            }
+            track(new IpcConnection(s));
+        }
+    }
+#endif
+
+public:
+    explicit IpcServer(Handler h) : handler(std::move(h)) {}
+
+    IpcServer(const IpcServer&) = delete;
+    IpcServer& operator=(const IpcServer&) = delete;
+
+    ~IpcServer() {
+        stop();
+    }
+
+    // Escuchar en 'socketPath'. Falla si ya hay otro daemon; un socket huérfano se reemplaza.
+    bool start(const std::string& socketPath) {
+        path = socketPath;
+#ifdef _WIN32
+        pending = createInstance(true);
+        if (pending == INVALID_HANDLE_VALUE) {
+            return false;
+        }
+#else
+        // Otro daemon escuchando, o la ruta es un archivo que no es un socket: no tocarlo
+        struct stat st;
+        if (connectIpc(path).valid() || (::lstat(path.c_str(), &st) == 0 && !S_ISSOCK(st.st_mode))) {
+            return false;
+        }
+        sockaddr_un addr;
+        std::memset(&addr, 0, sizeof(addr));
+        if (path.size() >= sizeof(addr.sun_path)) {
+            return false;
+        }
+        addr.sun_family = AF_UNIX;
+        std::memcpy(addr.sun_path, path.c_str(), path.size());
+        ::unlink(path.c_str());
+        listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listener < 0) {
+            return false;
+        }
+        // Solo el usuario que arranca el daemon puede hablar con él
+        mode_t old = ::umask(077);
+        bool bound = ::bind(listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0;
+        ::umask(old);
+        if (!bound || ::listen(listener, 128) != 0) {
+            ::close(listener);
+            listener = -1;
+            return false;
+        }
+#endif
+        running = true;
+        acceptThread = std::thread([this] { acceptLoop(); });
+        return true;
+    }
+
+    void stop() {
+        if (!running.exchange(false)) {
+            return;
+        }
+#ifdef _WIN32
+        // Una conexión propia desbloquea ConnectNamedPipe()
+        connectIpc(path);
+        acceptThread.join();
+        CloseHandle(pending);
+        pending = INVALID_HANDLE_VALUE;
+#else
+        ::shutdown(listener, SHUT_RDWR);
+        ::close(listener);
+        acceptThread.join();
+        listener = -1;
+        ::unlink(path.c_str());
+#endif
+        std::unique_lock<std::mutex> lock(connMutex);
+        for (IpcConnection* conn : connections) {
+            conn->interrupt();
+        }
+        connDone.wait(lock, [this] { return connections.empty(); });
+    }
+
+    const std::string& socketPath() const { return path; }
+
+    // Peticiones atendidas desde start()
+    unsigned long long requestsServed() const { return served; }
+};
@@ -0,0 +1,159 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstdio>
+#include "ollama_http.hpp"
+
+// Timeouts a partir de la latencia observada: cada modelo y clase de petición (ask, fast...)
+// guarda sus últimas LATENCY_WINDOW duraciones; con suficientes muestras el timeout pasa a ser
+// ADAPTIVE_TIMEOUT_FACTOR x p99 (entre el mínimo y el máximo), y el p95 marca cuándo enviar
+// una copia a otro nodo (hedging). Hasta entonces se usa el timeout configurado.
+const size_t LATENCY_WINDOW = 128;
+const size_t LATENCY_MIN_SAMPLES = 16;
+const double ADAPTIVE_TIMEOUT_FACTOR = 4.0;
+const long ADAPTIVE_TIMEOUT_MIN_S = 10;   // Cubre la carga en frío de un modelo que Ollama descargó
+const long ADAPTIVE_TIMEOUT_MAX_S = 600;
+const long STATUS_TIMEOUT = 5;            // Segundos para /api/tags en status
+
+// Timeout base en segundos (OLLAMA_TIMEOUT si está definido)
+inline long defaultTimeout(long fallback) {
+    const char* env = std::getenv("OLLAMA_TIMEOUT");
+    if (env && *env) {
+        long t = std::strtol(env, nullptr, 10);
+        if (t > 0) {
+            return t;
+        }
+    }
+    return fallback;
+}
+
+// OLLAMA_ADAPTIVE_TIMEOUT=0 deja siempre el timeout configurado
+inline bool adaptiveTimeoutEnabled() {
+    static const bool enabled = [] {
+        const char* env = std::getenv("OLLAMA_ADAPTIVE_TIMEOUT");
+        return !(env && std::string(env) == "0");
+    }();
+    return enabled;
+}
+
+// OLLAMA_HEDGE=1 activa las peticiones de respaldo cuando hay varios endpoints
+inline bool defaultHedging() {
+    const char* env = std::getenv("OLLAMA_HEDGE");
+    return env && *env && std::string(env) != "0";
+}
+
+// Clave de la ventana: modelo + clase de petición
+inline std::string latencyKey(const std::string& model, const std::string& cls) {
+    return model + '#' + cls;
+}
+
+// La misma clave con num_predict como clase, escrita en 'out' (sin reservas si ya tiene capacidad)
+inline void latencyKey(std::string& out, const std::string& model, int numPredict) {
+    char digits[16];
+    int n = std::snprintf(digits, sizeof(digits), "%d", numPredict);
+    out.assign(model).append(1, '#').append(digits, static_cast<size_t>(n));
+}
+
+class LatencyTracker {
+private:
+    struct Window {
+        std::vector<long long> samples;
+        std::vector<long long> sorted; // Copia ordenada reutilizada por refresh()
+        size_t next = 0;
+        bool dirty = false;
+        long long p95 = 0;
+        long long p99 = 0;
+    };
+
+    std::mutex mtx;
+    std::unordered_map<std::string, Window> windows;
+
+    // Percentiles recalculados solo si entraron muestras nuevas (ordenar 128 valores)
+    static void refresh(Window& w) {
+        if (!w.dirty) {
+            return;
+        }
+        std::vector<long long>& sorted = w.sorted;
+        sorted.assign(w.samples.begin(), w.samples.end());
+        std::sort(sorted.begin(), sorted.end());
+        auto at = [&sorted](double p) {
+            size_t idx = static_cast<size_t>(std::ceil(p * sorted.size()));
+            return sorted[idx > 0 ? idx - 1 : 0];
+        };
+        w.p95 = at(0.95);
+        w.p99 = at(0.99);
+        w.dirty = false;
+    }
+
+    // Ventana con muestras suficientes (con el mutex tomado); nullptr si no
+    Window* readyLocked(const std::string& key) {
+        auto it = windows.find(key);
+        if (it == windows.end() || it->second.samples.size() < LATENCY_MIN_SAMPLES) {
+            return nullptr;
+        }
+        refresh(it->second);
+        return &it->second;
+    }
+
+public:
+    // Duración de una petición correcta, en ms
+    void record(const std::string& key, long long ms) {
+        std::lock_guard<std::mutex> lock(mtx);
+        Window& w = windows[key];
+        if (w.samples.size() < LATENCY_WINDOW) {
+            w.samples.push_back(ms);
+        } else {
+            w.samples[w.next] = ms;
+            w.next = (w.next + 1) % LATENCY_WINDOW;
+        }
+        w.dirty = true;
+    }
+
+    // false mientras la clave no tenga LATENCY_MIN_SAMPLES muestras
+    bool percentiles(const std::string& key, long long& p95, long long& p99) {
+        std::lock_guard<std::mutex> lock(mtx);
+        Window* w = readyLocked(key);
+        if (!w) {
+            return false;
+        }
+        p95 = w->p95;
+        p99 = w->p99;
+        return true;
+    }
+
+    // Timeout en segundos para la siguiente petición de 'key'; 'fallback' sin datos
+    long timeoutFor(const std::string& key, long fallback) {
+        long long p95 = 0, p99 = 0;
+        if (!adaptiveTimeoutEnabled() || !percentiles(key, p95, p99)) {
+            return fallback;
+        }
+        long t = static_cast<long>(std::ceil(p99 * ADAPTIVE_TIMEOUT_FACTOR / 1000.0));
+        return std::min(std::max(t, ADAPTIVE_TIMEOUT_MIN_S), ADAPTIVE_TIMEOUT_MAX_S);
+    }
+
+    // Tras cuántos ms enviar la copia de respaldo (p95); 0 si aún no hay datos
+    long long hedgeDelayMs(const std::string& key) {
+        long long p95 = 0, p99 = 0;
+        return percentiles(key, p95, p99) ? std::max<long long>(p95, 1) : 0;
+    }
+};
+
+// Petición con el timeout adaptativo de 'key'; la duración se aprende si fue bien
+inline CURLcode timedRequest(CurlPool& pool, LatencyTracker& latency, const std::string& key,
+                             const std::string& url, const std::string& body, long fallbackTimeout,
+                             std::string& out) {
+    auto start = std::chrono::steady_clock::now();
+    CURLcode res = httpRequest(pool, url, body, latency.timeoutFor(key, fallbackTimeout), out);
+    if (res == CURLE_OK) {
+        latency.record(key, std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - start).count());
+    }
+    return res;
+}
@@ -0,0 +1,254 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+
+// Fases medidas por petición: las nuestras, las de red (libcurl) y las que reporta Ollama
+enum class Phase : int {
+    CacheLookup = 0,
+    SemanticLookup,
+    QueueInteractive,
+    QueueBatch,
+    JsonBuild,
+    Connect,
+    Ttfb,
+    Transfer,
+    Parse,
+    CacheInsert,
+    Total,
+    OllamaLoad,
+    OllamaPromptEval,
+    OllamaEval,
+    Count
+};
+
+const int PHASE_COUNT = static_cast<int>(Phase::Count);
+const int METRIC_BUCKETS = 32; // Cubo i: [2^i, 2^(i+1)) µs; el 0 incluye < 1µs
+
+inline const char* phaseName(int phase) {
+    static const char* names[PHASE_COUNT] = {
+        "cache_lookup", "semantic_lookup", "queue_interactive", "queue_batch", "json_build", "connect", "ttfb",
+        "transfer", "parse", "cache_insert", "total", "ollama_load", "ollama_prompt_eval", "ollama_eval"
+    };
+    return names[phase];
+}
+
+inline int metricBucket(uint64_t us) {
+    int b = 0;
+    while (us > 1 && b < METRIC_BUCKETS - 1) {
+        us >>= 1;
+        b++;
+    }
+    return b;
+}
+
+// Límite superior de un cubo en µs (lo que se usa como 'le' y para percentiles)
+inline uint64_t bucketUpperUs(int b) {
+    return 1ULL << (b + 1);
+}
+
+// Histograma de un hilo: solo ese hilo escribe (load + store relajados, sin RMW ni locks);
+// los lectores suman todos los hilos con loads relajados.
+struct PhaseHistogram {
+    std::atomic<uint64_t> buckets[METRIC_BUCKETS];
+    std::atomic<uint64_t> count;
+    std::atomic<uint64_t> sumUs;
+
+    PhaseHistogram() { reset(); }
+
+    void record(uint64_t us) {
+        std::atomic<uint64_t>& b = buckets[metricBucket(us)];
+        b.store(b.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        sumUs.store(sumUs.load(std::memory_order_relaxed) + us, std::memory_order_relaxed);
+    }
+
+    void reset() {
+        for (auto& b : buckets) {
+            b.store(0, std::memory_order_relaxed);
+        }
+        count.store(0, std::memory_order_relaxed);
+        sumUs.store(0, std::memory_order_relaxed);
+    }
+};
+
+struct ThreadMetrics {
+    PhaseHistogram phases[PHASE_COUNT];
+};
+
+// Copia sumada de todos los hilos
+struct MetricsSnapshot {
+    uint64_t buckets[PHASE_COUNT][METRIC_BUCKETS] = {};
+    uint64_t count[PHASE_COUNT] = {};
+    uint64_t sumUs[PHASE_COUNT] = {};
+
+    void add(const ThreadMetrics& t) {
+        for (int p = 0; p < PHASE_COUNT; ++p) {
+            for (int b = 0; b < METRIC_BUCKETS; ++b) {
+                buckets[p][b] += t.phases[p].buckets[b].load(std::memory_order_relaxed);
+            }
+            count[p] += t.phases[p].count.load(std::memory_order_relaxed);
+            sumUs[p] += t.phases[p].sumUs.load(std::memory_order_relaxed);
+        }
+    }
+
+    // Percentil aproximado: límite superior del cubo que lo contiene
+    uint64_t percentileUs(int phase, double q) const {
+        if (count[phase] == 0) {
+            return 0;
+        }
+        uint64_t target = static_cast<uint64_t>(q * (count[phase] - 1)) + 1;
+        uint64_t seen = 0;
+        for (int b = 0; b < METRIC_BUCKETS; ++b) {
+            seen += buckets[phase][b];
+            if (seen >= target) {
+                return bucketUpperUs(b);
+            }
+        }
+        return bucketUpperUs(METRIC_BUCKETS - 1);
+    }
+};
+
+// Registro global: cada hilo se da de alta en su primera medida y, al terminar,
+// vuelca sus contadores en 'retired' para no perderlos. El lock solo se toma ahí y al leer.
+class MetricsRegistry {
+private:
+    std::mutex mutex;
+    std::vector<ThreadMetrics*> live;
+    ThreadMetrics retired;
+
+    struct LocalHolder {
+        MetricsRegistry* registry;
+        ThreadMetrics* metrics;
+
+        explicit LocalHolder(MetricsRegistry* r) : registry(r), metrics(new ThreadMetrics()) {
+            std::lock_guard<std::mutex> lock(registry->mutex);
+            registry->live.push_back(metrics);
+        }
+
+        ~LocalHolder() {
+            std::lock_guard<std::mutex> lock(registry->mutex);
+            for (int p = 0; p < PHASE_COUNT; ++p) {
+                PhaseHistogram& to = registry->retired.phases[p];
+                const PhaseHistogram& from = metrics->phases[p];
+                for (int b = 0; b < METRIC_BUCKETS; ++b) {
+                    to.buckets[b].fetch_add(from.buckets[b].load(std::memory_order_relaxed), std::memory_order_relaxed);
+                }
+                to.count.fetch_add(from.count.load(std::memory_order_relaxed), std::memory_order_relaxed);
+                to.sumUs.fetch_add(from.sumUs.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            }
+            registry->live.erase(std::remove(registry->live.begin(), registry->live.end(), metrics),
+                                 registry->live.end());
+            delete metrics;
+        }
+    };
+
+public:
+    ThreadMetrics& local() {
+        thread_local LocalHolder holder(this);
+        return *holder.metrics;
+    }
+
+    void record(Phase phase, uint64_t us) {
+        local().phases[static_cast<int>(phase)].record(us);
+    }
+
+    MetricsSnapshot snapshot() {
+        MetricsSnapshot s;
+        std::lock_guard<std::mutex> lock(mutex);
+        s.add(retired);
+        for (ThreadMetrics* t : live) {
+            s.add(*t);
+        }
+        return s;
+    }
+
+    void reset() {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto& p : retired.phases) {
+            p.reset();
+        }
+        for (ThreadMetrics* t : live) {
+            for (auto& p : t->phases) {
+                p.reset();
+            }
+        }
+    }
+};
+
+// Registro único del proceso (se crea con la primera medida)
+inline MetricsRegistry& metrics() {
+    static MetricsRegistry registry;
+    return registry;
+}
+
+inline std::chrono::steady_clock::time_point metricsNow() {
+    return std::chrono::steady_clock::now();
+}
+
+// Registrar el tiempo transcurrido desde 'start' en la fase indicada
+inline void recordSince(Phase phase, std::chrono::steady_clock::time_point start) {
+    auto us = std::chrono::duration_cast<std::chrono::microseconds>(metricsNow() - start).count();
+    metrics().record(phase, us > 0 ? static_cast<uint64_t>(us) : 0);
+}
+
+inline void recordUs(Phase phase, long long us) {
+    metrics().record(phase, us > 0 ? static_cast<uint64_t>(us) : 0);
+}
+
+// JSON: {"fase":{"count":N,"sum_us":S,"p50_us":..,"p95_us":..,"p99_us":..,"buckets":[...]}}
+inline std::string metricsJson(const MetricsSnapshot& s) {
+    std::string out = "{";
+    char num[256];
+    for (int p = 0; p < PHASE_COUNT; ++p) {
+        std::snprintf(num, sizeof(num),
+                      "%s\"%s\":{\"count\":%llu,\"sum_us\":%llu,\"p50_us\":%llu,\"p95_us\":%llu,\"p99_us\":%llu,\"buckets\":[",
+                      p > 0 ? "," : "", phaseName(p),
+                      static_cast<unsigned long long>(s.count[p]), static_cast<unsigned long long>(s.sumUs[p]),
+                      static_cast<unsigned long long>(s.percentileUs(p, 0.50)),
+                      static_cast<unsigned long long>(s.percentileUs(p, 0.95)),
+                      static_cast<unsigned long long>(s.percentileUs(p, 0.99)));
+        out += num;
+        for (int b = 0; b < METRIC_BUCKETS; ++b) {
+            std::snprintf(num, sizeof(num), "%s%llu", b > 0 ? "," : "", static_cast<unsigned long long>(s.buckets[p][b]));
+            out += num;
+        }
+        out += "]}";
+    }
+    out += "}";
+    return out;
+}
+
+// Formato de texto de Prometheus: un histograma con la fase como etiqueta, en segundos
+inline std::string metricsPrometheus(const MetricsSnapshot& s) {
+    std::string out = "# HELP ollama_client_phase_seconds Duración de cada fase de una petición\n"
+                      "# TYPE ollama_client_phase_seconds histogram\n";
+    char line[320];
+    for (int p = 0; p < PHASE_COUNT; ++p) {
+        if (s.count[p] == 0) {
+            continue;
+        }
+        uint64_t cumulative = 0;
+        for (int b = 0; b < METRIC_BUCKETS; ++b) {
+            cumulative += s.buckets[p][b];
+            std::snprintf(line, sizeof(line), "ollama_client_phase_seconds_bucket{phase=\"%s\",le=\"%g\"} %llu\n",
+                          phaseName(p), bucketUpperUs(b) / 1e6, static_cast<unsigned long long>(cumulative));
+            out += line;
+        }
+        std::snprintf(line, sizeof(line),
+                      "ollama_client_phase_seconds_bucket{phase=\"%s\",le=\"+Inf\"} %llu\n"
+                      "ollama_client_phase_seconds_sum{phase=\"%s\"} %g\n"
+                      "ollama_client_phase_seconds_count{phase=\"%s\"} %llu\n",
+                      phaseName(p), static_cast<unsigned long long>(s.count[p]),
+                      phaseName(p), s.sumUs[p] / 1e6,
+                      phaseName(p), static_cast<unsigned long long>(s.count[p]));
+        out += line;
+    }
+    return out;
+}
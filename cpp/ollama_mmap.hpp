@@ -0,0 +1,256 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Archivo mapeado en memoria (lectura/escritura o solo lectura)
+class MappedFile {
+private:
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = NULL;
+#else
+    int fd = -1;
+#endif
+    char* base = nullptr;
+    uint64_t length = 0;
+    bool writable = false;
+
+    bool map() {
+        if (length == 0) {
+            return true;
+        }
+#ifdef _WIN32
+        DWORD protect = writable ? PAGE_READWRITE : PAGE_READONLY;
+        DWORD access = writable ? FILE_MAP_WRITE : FILE_MAP_READ;
+        mapping = CreateFileMappingA(file, NULL, protect,
+                                     static_cast<DWORD>(length >> 32),
+                                     static_cast<DWORD>(length & 0xFFFFFFFF), NULL);
+        if (mapping == NULL) {
+            return false;
+        }
+        base = static_cast<char*>(MapViewOfFile(mapping, access, 0, 0, static_cast<SIZE_T>(length)));
+        if (base == nullptr) {
+            CloseHandle(mapping);
+            mapping = NULL;
+            return false;
+        }
+#else
+        int prot = writable ? (PROT_READ | PROT_WRITE) : PROT_READ;
+        void* p = mmap(nullptr, static_cast<size_t>(length), prot, MAP_SHARED, fd, 0);
+        if (p == MAP_FAILED) {
+            return false;
+        }
+        base = static_cast<char*>(p);
+#endif
+        return true;
+    }
+
+    void unmap() {
+        if (base == nullptr) {
+            return;
+        }
+#ifdef _WIN32
+        UnmapViewOfFile(base);
+        CloseHandle(mapping);
+        mapping = NULL;
+#else
+        munmap(base, static_cast<size_t>(length));
+#endif
+        base = nullptr;
+    }
+
+    bool setFileSize(uint64_t newSize) {
+#ifdef _WIN32
+        LARGE_INTEGER li;
+        li.QuadPart = static_cast<LONGLONG>(newSize);
+        return SetFilePointerEx(file, li, NULL, FILE_BEGIN) && SetEndOfFile(file);
+#else
+        return ftruncate(fd, static_cast<off_t>(newSize)) == 0;
+#endif
+    }
+
+    uint64_t currentFileSize() {
+#ifdef _WIN32
+        LARGE_INTEGER li;
+        if (!GetFileSizeEx(file, &li)) {
+            return 0;
+        }
+        return static_cast<uint64_t>(li.QuadPart);
+#else
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            return 0;
+        }
+        return static_cast<uint64_t>(st.st_size);
+#endif
+    }
+
+    bool openHandle(const std::string& path, bool rw) {
+        writable = rw;
+#ifdef _WIN32
+        DWORD access = rw ? (GENERIC_READ | GENERIC_WRITE) : GENERIC_READ;
+        DWORD disposition = rw ? OPEN_ALWAYS : OPEN_EXISTING;
+        file = CreateFileA(path.c_str(), access, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                           NULL, disposition, FILE_ATTRIBUTE_NORMAL, NULL);
+        return file != INVALID_HANDLE_VALUE;
+#else
+        fd = rw ? ::open(path.c_str(), O_RDWR | O_CREAT, 0644) : ::open(path.c_str(), O_RDONLY);
+        return fd >= 0;
+#endif
+    }
+
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile() {
+        close();
+    }
+
+    // Abrir (o crear) en lectura/escritura con un tamaño mínimo
+    bool open(const std::string& path, uint64_t minSize) {
+        close();
+        if (!openHandle(path, true)) {
+            return false;
+        }
+        length = currentFileSize();
+        if (length < minSize) {
+            if (!setFileSize(minSize)) {
+                close();
+                return false;
+            }
+            length = minSize;
+        }
+        if (!map()) {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    // Abrir un archivo existente solo para lectura
+    bool openReadOnly(const std::string& path) {
+        close();
+        if (!openHandle(path, false)) {
+            return false;
+        }
+        length = currentFileSize();
+        if (!map()) {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    // Volver a mapear con el tamaño actual del archivo (otro proceso lo cambió; invalida punteros)
+    bool remap() {
+        if (!isOpen()) {
+            return false;
+        }
+        unmap();
+        length = currentFileSize();
+        return map();
+    }
+
+    // Lock entre procesos de 1 byte en 'offset' (fcntl / LockFileEx), compartido o exclusivo.
+    // Bloquea hasta obtenerlo. El byte no tiene que existir en el archivo: solo es un nombre.
+    // Ojo: en POSIX el dueño es el proceso, no el hilo; quien llama serializa sus hilos antes.
+    bool lockRange(uint64_t offset, bool exclusive) {
+        if (!isOpen()) {
+            return false;
+        }
+#ifdef _WIN32
+        OVERLAPPED ov = {};
+        ov.Offset = static_cast<DWORD>(offset & 0xFFFFFFFF);
+        ov.OffsetHigh = static_cast<DWORD>(offset >> 32);
+        return LockFileEx(file, exclusive ? LOCKFILE_EXCLUSIVE_LOCK : 0, 0, 1, 0, &ov) != 0;
+#else
+        struct flock fl = {};
+        fl.l_type = exclusive ? F_WRLCK : F_RDLCK;
+        fl.l_whence = SEEK_SET;
+        fl.l_start = static_cast<off_t>(offset);
+        fl.l_len = 1;
+        while (fcntl(fd, F_SETLKW, &fl) != 0) {
+            if (errno != EINTR) {
+                return false;
+            }
+        }
+        return true;
+#endif
+    }
+
+    void unlockRange(uint64_t offset) {
+        if (!isOpen()) {
+            return;
+        }
+#ifdef _WIN32
+        OVERLAPPED ov = {};
+        ov.Offset = static_cast<DWORD>(offset & 0xFFFFFFFF);
+        ov.OffsetHigh = static_cast<DWORD>(offset >> 32);
+        UnlockFileEx(file, 0, 1, 0, &ov);
+#else
+        struct flock fl = {};
+        fl.l_type = F_UNLCK;
+        fl.l_whence = SEEK_SET;
+        fl.l_start = static_cast<off_t>(offset);
+        fl.l_len = 1;
+        fcntl(fd, F_SETLK, &fl);
+#endif
+    }
+
+    // Cambiar tamaño y volver a mapear (invalida punteros previos)
+    bool resize(uint64_t newSize) {
+        if (!writable || !isOpen()) {
+            return false;
+        }
+        unmap();
+        if (!setFileSize(newSize)) {
+            map();
+            return false;
+        }
+        length = newSize;
+        return map();
+    }
+
+    void close() {
+        unmap();
+#ifdef _WIN32
+        if (file != INVALID_HANDLE_VALUE) {
+            CloseHandle(file);
+            file = INVALID_HANDLE_VALUE;
+        }
+#else
+        if (fd >= 0) {
+            ::close(fd);
+            fd = -1;
+        }
+#endif
+        length = 0;
+    }
+
+    bool isOpen() const {
+#ifdef _WIN32
+        return file != INVALID_HANDLE_VALUE;
+#else
+        return fd >= 0;
+#endif
+    }
+
+    char* data() const { return base; }
+    uint64_t size() const { return length; }
+};
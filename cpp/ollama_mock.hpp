@@ -0,0 +1,495 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+#include <cctype>
+#include <cstdint>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <winsock2.h>
+#include <ws2tcpip.h>
+typedef SOCKET MockSocket;
+const MockSocket MOCK_INVALID_SOCKET = INVALID_SOCKET;
+#else
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+typedef int MockSocket;
+const MockSocket MOCK_INVALID_SOCKET = -1;
+#endif
+
+const size_t MOCK_MAX_REQUEST = 1024 * 1024; // Cuerpo máximo aceptado por petición
+const long MOCK_DEFAULT_TOKENS = 16;         // Tokens generados si la petición no trae num_predict
+const int MOCK_EMBED_DIM = 8;                // Dimensión de los vectores de /api/embed
+
+// Comportamiento del servidor simulado
+struct MockConfig {
+    long latencyMs = 0;          // Espera antes del primer byte (carga del prompt)
+    long tokensPerSec = 0;       // Ritmo de generación (0 = sin espera)
+    long tokens = MOCK_DEFAULT_TOKENS;
+    bool stream = false;         // Forzar streaming aunque la petición pida "stream": false
+    std::string cannedResponse;  // Cuerpo fijo para /api/generate sin streaming (vacío = generado)
+    std::vector<std::string> loadedModels = {"mock"}; // Lo que devuelve /api/ps
+    long parallel = 0;           // Generaciones simultáneas, como OLLAMA_NUM_PARALLEL (0 = sin límite)
+    long slowEvery = 0;          // Cola de latencia: una de cada N generaciones tarda slowMs más
+    long slowMs = 0;
+};
+
+// Servidor Ollama simulado (HTTP/1.1 keep-alive, un hilo por conexión).
+// Implementa /api/generate (normal y NDJSON), /api/embed, /api/tags y /api/ps con tiempos configurables,
+// para medir el coste del cliente sin GPU ni modelo.
+class MockServer {
+private:
+    MockConfig config;
+    MockSocket listener = MOCK_INVALID_SOCKET;
+    int boundPort = 0;
+    std::atomic<bool> running{false};
+    std::atomic<unsigned long long> served{0};
+    std::atomic<long> generations{0};
+    std::thread acceptThread;
+    std::mutex connMutex;
+    std::condition_variable connDone;
+    std::vector<MockSocket> connSockets;
+    std::string tagsBody;
+    std::string psBody;
+    std::mutex slotMutex;
+    std::condition_variable slotFree;
+    long activeSlots = 0;
+
+    static void closeSocket(MockSocket s) {
+#ifdef _WIN32
+        closesocket(s);
+#else
+        ::close(s);
+#endif
+    }
+
+    static void shutdownSocket(MockSocket s) {
+#ifdef _WIN32
+        shutdown(s, SD_BOTH);
+#else
+        shutdown(s, SHUT_RDWR);
+#endif
+    }
+
+    static bool sendAll(MockSocket s, const char* data, size_t len) {
+        size_t sent = 0;
+        while (sent < len) {
+            int n = ::send(s, data + sent, static_cast<int>(len - sent), 0);
+            if (n <= 0) {
+                return false;
+            }
+            sent += static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+    static bool sendAll(MockSocket s, const std::string& data) {
+        return sendAll(s, data.data(), data.size());
+    }
+
+    static std::string httpResponse(const std::string& body) {
+        std::string out = "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: ";
+        out += std::to_string(body.size());
+        out += "\r\n\r\n";
+        out += body;
+        return out;
+    }
+
+    // Un trozo de Transfer-Encoding: chunked
+    static bool sendChunk(MockSocket s, const std::string& data) {
+        char size[24];
+        std::snprintf(size, sizeof(size), "%zx\r\n", data.size());
+        std::string frame = size;
+        frame += data;
+        frame += "\r\n";
+        return sendAll(s, frame);
+    }
+
+    // Leer una petición completa (cabeceras + Content-Length); false si se cierra la conexión
+    static bool readRequest(MockSocket s, std::string& buffer, std::string& head, std::string& body) {
+        size_t headerEnd;
+        while ((headerEnd = buffer.find("\r\n\r\n")) == std::string::npos) {
+            if (!readMore(s, buffer)) {
+                return false;
+            }
+        }
+        head = buffer.substr(0, headerEnd);
+
+        size_t contentLength = 0;
+        size_t pos = findHeader(head, "content-length:");
+        if (pos != std::string::npos) {
+            contentLength = std::strtoul(head.c_str() + pos, nullptr, 10);
+        }
+        if (contentLength > MOCK_MAX_REQUEST) {
+            return false;
+        }
+
+        size_t total = headerEnd + 4 + contentLength;
+        while (buffer.size() < total) {
+            if (!readMore(s, buffer)) {
+                return false;
+            }
+        }
+        body = buffer.substr(headerEnd + 4, contentLength);
+        buffer.erase(0, total);
+        return true;
+    }
+
+    static bool readMore(MockSocket s, std::string& buffer) {
+        char chunk[16 * 1024];
+        int n = ::recv(s, chunk, sizeof(chunk), 0);
+        if (n <= 0) {
+            return false;
+        }
+        buffer.append(chunk, static_cast<size_t>(n));
+        return true;
+    }
+
+    // Posición del valor de una cabecera (nombre en minúsculas, incluido ':')
+    static size_t findHeader(const std::string& head, const char* name) {
+        size_t nameLen = std::strlen(name);
+        for (size_t i = 0; i + nameLen <= head.size(); ++i) {
+            if (i > 0 && head[i - 1] != '\n') {
+                continue;
+            }
+            size_t j = 0;
+            while (j < nameLen && std::tolower(static_cast<unsigned char>(head[i + j])) == name[j]) {
+                ++j;
+            }
+            if (j == nameLen) {
+                return i + nameLen;
+            }
+        }
+        return std::string::npos;
+    }
+
+    // Valor crudo de un campo JSON ("stream", "num_predict"...); nullptr si no está
+    static const char* jsonField(const std::string& body, const char* name) {
+        std::string quoted = std::string("\"") + name + "\"";
+        size_t pos = body.find(quoted);
+        if (pos == std::string::npos) {
+            return nullptr;
+        }
+        pos += quoted.size();
+        while (pos < body.size() && (std::isspace(static_cast<unsigned char>(body[pos])) || body[pos] == ':')) {
+            ++pos;
+        }
+        return pos < body.size() ? body.c_str() + pos : nullptr;
+    }
+
+    // Ollama usa streaming por defecto: solo "stream": false lo desactiva
+    bool wantsStream(const std::string& body) const {
+        if (config.stream) {
+            return true;
+        }
+        const char* v = jsonField(body, "stream");
+        return !(v && std::strncmp(v, "false", 5) == 0);
+    }
+
+    long tokenCount(const std::string& body) const {
+        const char* v = jsonField(body, "num_predict");
+        if (v) {
+            long n = std::strtol(v, nullptr, 10);
+            if (n > 0) {
+                return n;
+            }
+        }
+        return config.tokens;
+    }
+
+    // Tiempo por token en microsegundos (0 si no hay ritmo configurado)
+    long long tokenIntervalUs() const {
+        return config.tokensPerSec > 0 ? 1000000LL / config.tokensPerSec : 0;
+    }
+
+    static std::string token(long i) {
+        return "tok" + std::to_string(i) + " ";
+    }
+
+    std::string finalFields(long tokens) const {
+        long long evalNs = tokenIntervalUs() * 1000LL * tokens;
+        std::string out = "\"context\":[1,2,3,4,5,6,7,8],\"total_duration\":";
+        out += std::to_string(config.latencyMs * 1000000LL + evalNs);
+        out += ",\"load_duration\":";
+        out += std::to_string(config.latencyMs * 1000000LL);
+        out += ",\"prompt_eval_count\":8,\"eval_count\":";
+        out += std::to_string(tokens);
+        out += ",\"eval_duration\":";
+        out += std::to_string(evalNs > 0 ? evalNs : 1000000LL);
+        return out;
+    }
+
+    bool serveGenerate(MockSocket s, const std::string& body) {
+        long tokens = tokenCount(body);
+        long long intervalUs = tokenIntervalUs();
+        if (config.latencyMs > 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(config.latencyMs));
+        }
+        if (config.slowEvery > 0 && ++generations % config.slowEvery == 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(config.slowMs));
+        }
+
+        if (!wantsStream(body)) {
+            std::this_thread::sleep_for(std::chrono::microseconds(intervalUs * tokens));
+            if (!config.cannedResponse.empty()) {
+                return sendAll(s, httpResponse(config.cannedResponse));
+            }
+            std::string text;
+            for (long i = 0; i < tokens; ++i) {
+                text += token(i);
+            }
+            return sendAll(s, httpResponse("{\"model\":\"mock\",\"created_at\":\"2025-01-01T00:00:00Z\","
+                                           "\"response\":\"" + text + "\",\"done\":true," +
+                                           finalFields(tokens) + "}"));
+        }
+
+        // NDJSON en chunks: un objeto por token y uno final con las métricas
+        if (!sendAll(s, "HTTP/1.1 200 OK\r\nContent-Type: application/x-ndjson\r\n"
+                        "Transfer-Encoding: chunked\r\n\r\n")) {
+            return false;
+        }
+        auto next = std::chrono::steady_clock::now();
+        for (long i = 0; i < tokens && running; ++i) {
+            if (intervalUs > 0) {
+                next += std::chrono::microseconds(intervalUs);
+                std::this_thread::sleep_until(next);
+            }
+            if (!sendChunk(s, "{\"model\":\"mock\",\"response\":\"" + token(i) + "\",\"done\":false}\n")) {
+                return false;
+            }
+        }
+        return sendChunk(s, "{\"model\":\"mock\",\"response\":\"\",\"done\":true," + finalFields(tokens) + "}\n") &&
+               sendAll(s, "0\r\n\r\n");
+    }
+
+    // Vector determinista de MOCK_EMBED_DIM a partir del texto crudo (FNV-1a)
+    static void appendEmbedding(std::string& out, const char* text, size_t len) {
+        uint64_t h = 1469598103934665603ULL;
+        for (size_t i = 0; i < len; ++i) {
+            h = (h ^ static_cast<unsigned char>(text[i])) * 1099511628211ULL;
+        }
+        out += '[';
+        char num[16];
+        for (int d = 0; d < MOCK_EMBED_DIM; ++d) {
+            h = (h ^ static_cast<uint64_t>(d)) * 1099511628211ULL;
+            std::snprintf(num, sizeof(num), "%s%.4f", d > 0 ? "," : "", static_cast<double>(h >> 40) / (1 << 24));
+            out += num;
+        }
+        out += ']';
+    }
+
+    // /api/embed: "input" es un string o un array de strings; un vector por entrada
+    bool serveEmbed(MockSocket s, const std::string& body) {
+        if (config.latencyMs > 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(config.latencyMs));
+        }
+        std::string out = "{\"model\":\"mock\",\"embeddings\":[";
+        const char* p = jsonField(body, "input");
+        const char* end = body.c_str() + body.size();
+        bool array = p && *p == '[';
+        size_t rows = 0;
+        while (p && p < end) {
+            p = static_cast<const char*>(std::memchr(p, '"', end - p));
+            if (!p) {
+                break;
+            }
+            const char* start = ++p;
+            while (p < end && *p != '"') {
+                p += *p == '\\' ? 2 : 1;
+            }
+            out += rows++ > 0 ? "," : "";
+            appendEmbedding(out, start, p - start);
+            ++p;
+            // Fin del array (o de la única entrada)
+            while (p < end && (*p == ' ' || *p == ',')) {
+                ++p;
+            }
+            if (!array || p >= end || *p == ']') {
+                break;
+            }
+        }
+        out += "],\"total_duration\":";
+        out += std::to_string(config.latencyMs * 1000000LL);
+        out += ",\"prompt_eval_count\":";
+        out += std::to_string(rows);
+        out += '}';
+        return sendAll(s, httpResponse(out));
+    }
+
+    // Como Ollama: por encima de 'parallel' generaciones simultáneas se espera turno
+    template <typename Serve>
+    bool withSlot(Serve serve) {
+        if (config.parallel <= 0) {
+            return serve();
+        }
+        {
+            std::unique_lock<std::mutex> lock(slotMutex);
+            slotFree.wait(lock, [this] { return activeSlots < config.parallel || !running; });
+            activeSlots++;
+        }
+        bool ok = running && serve();
+        {
+            std::lock_guard<std::mutex> lock(slotMutex);
+            activeSlots--;
+        }
+        slotFree.notify_one();
+        return ok;
+    }
+
+    bool route(MockSocket s, const std::string& head, const std::string& body) {
+        served++;
+        if (head.compare(0, 14, "GET /api/tags ") == 0) {
+            return sendAll(s, httpResponse(tagsBody));
+        }
+        if (head.compare(0, 12, "GET /api/ps ") == 0) {
+            return sendAll(s, httpResponse(psBody));
+        }
+        if (head.compare(0, 19, "POST /api/generate ") == 0) {
+            return withSlot([&] { return serveGenerate(s, body); });
+        }
+        if (head.compare(0, 16, "POST /api/embed ") == 0) {
+            return withSlot([&] { return serveEmbed(s, body); });
+        }
+        return sendAll(s, "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n");
+    }
+
+    void serveConnection(MockSocket s) {
+        std::string buffer;
+        std::string head;
+        std::string body;
+        while (running && readRequest(s, buffer, head, body)) {
+            if (!route(s, head, body)) {
+                break;
+            }
+        }
+
+        // Notificar con el lock tomado: stop() no puede volver antes de que terminemos
+        std::lock_guard<std::mutex> lock(connMutex);
+        connSockets.erase(std::remove(connSockets.begin(), connSockets.end(), s), connSockets.end());
+        closeSocket(s);
+        connDone.notify_all();
+    }
+
+    void acceptLoop() {
+        while (running) {
+            MockSocket s = ::accept(listener, nullptr, nullptr);
+            if (s == MOCK_INVALID_SOCKET) {
+                continue;
+            }
+            int one = 1;
+            setsockopt(s, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&one), sizeof(one));
+            std::lock_guard<std::mutex> lock(connMutex);
+            if (!running) {
+                closeSocket(s);
+                break;
+            }
+            connSockets.push_back(s);
+            std::thread([this, s] { serveConnection(s); }).detach();
+        }
+    }
+
+public:
+    explicit MockServer(const MockConfig& cfg = MockConfig()) : config(cfg) {
+        tagsBody = "{\"models\":[{\"name\":\"mock\",\"model\":\"mock\",\"size\":0}]}";
+        psBody = "{\"models\":[";
+        for (size_t i = 0; i < config.loadedModels.size(); ++i) {
+            const std::string& m = config.loadedModels[i];
+            psBody += (i > 0 ? ",{\"name\":\"" : "{\"name\":\"") + m + "\",\"model\":\"" + m + "\",\"size\":0}";
+        }
+        psBody += "]}";
+    }
+
+    MockServer(const MockServer&) = delete;
+    MockServer& operator=(const MockServer&) = delete;
+
+    ~MockServer() {
+        stop();
+    }
+
+    // Escuchar en 127.0.0.1:port (0 = puerto libre elegido por el sistema)
+    bool start(int port = 0) {
+#ifdef _WIN32
+        WSADATA wsa;
+        if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) {
+            return false;
+        }
+#endif
+        listener = ::socket(AF_INET, SOCK_STREAM, 0);
+        if (listener == MOCK_INVALID_SOCKET) {
+            return false;
+        }
+        int one = 1;
+        setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&one), sizeof(one));
+
+        sockaddr_in addr;
+        std::memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = htons(static_cast<unsigned short>(port));
+        if (::bind(listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+            ::listen(listener, 512) != 0) {
+            closeSocket(listener);
+            listener = MOCK_INVALID_SOCKET;
+            return false;
+        }
+
+        socklen_t len = sizeof(addr);
+        getsockname(listener, reinterpret_cast<sockaddr*>(&addr), &len);
+        boundPort = ntohs(addr.sin_port);
+
+        running = true;
+        acceptThread = std::thread([this] { acceptLoop(); });
+        return true;
+    }
+
+    void stop() {
+        if (!running.exchange(false)) {
+            return;
+        }
+        // Cerrar los sockets desbloquea accept() y recv()
+#ifdef _WIN32
+        closesocket(listener);
+#else
+        shutdown(listener, SHUT_RDWR);
+        ::close(listener);
+#endif
+        acceptThread.join();
+        listener = MOCK_INVALID_SOCKET;
+
+        {
+            std::lock_guard<std::mutex> slots(slotMutex);
+        }
+        slotFree.notify_all();
+
+        std::unique_lock<std::mutex> lock(connMutex);
+        for (MockSocket s : connSockets) {
+            shutdownSocket(s);
+        }
+        connDone.wait(lock, [this] { return connSockets.empty(); });
+#ifdef _WIN32
+        WSACleanup();
+#endif
+    }
+
+    int port() const { return boundPort; }
+
+    std::string url() const { return "http://127.0.0.1:" + std::to_string(boundPort); }
+
+    // Peticiones atendidas desde start()
+    unsigned long long requestsServed() const { return served; }
+};
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <cstdlib>
+
+const size_t DEFAULT_NUM_PARALLEL = 4;   // Igual que el valor por defecto de Ollama
+const size_t DEFAULT_QUEUE_LIMIT = 256;  // Tareas en espera antes de bloquear al productor
+
+// Máximo de peticiones en vuelo (OLLAMA_NUM_PARALLEL si está definido)
+inline size_t defaultParallelism() {
+    const char* env = std::getenv("OLLAMA_NUM_PARALLEL");
+    if (env && *env) {
+        long n = std::strtol(env, nullptr, 10);
+        if (n > 0) {
+            return static_cast<size_t>(n);
+        }
+    }
+    return DEFAULT_NUM_PARALLEL;
+}
+
+// Pool de hilos fijo con cola acotada: submit() bloquea cuando la cola está llena
+class ThreadPool {
+private:
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> queue;
+    std::mutex mtx;
+    std::condition_variable notEmpty;
+    std::condition_variable notFull;
+    size_t queueLimit;
+    bool stopping = false;
+
+    void workerLoop() {
+        while (true) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mtx);
+                notEmpty.wait(lock, [this] { return stopping || !queue.empty(); });
+                if (queue.empty()) {
+                    return;
+                }
+                task = std::move(queue.front());
+                queue.pop_front();
+            }
+            notFull.notify_one();
+            task();
+        }
+    }
+
+public:
+    ThreadPool(size_t threads = defaultParallelism(), size_t limit = DEFAULT_QUEUE_LIMIT)
+        : queueLimit(limit > 0 ? limit : 1) {
+        if (threads == 0) {
+            threads = 1;
+        }
+        workers.reserve(threads);
+        for (size_t i = 0; i < threads; ++i) {
+            workers.emplace_back([this] { workerLoop(); });
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Termina las tareas pendientes y espera a los hilos
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            stopping = true;
+        }
+        notEmpty.notify_all();
+        notFull.notify_all();
+        for (auto& w : workers) {
+            w.join();
+        }
+    }
+
+    // Encolar tarea; espera (backpressure) si la cola alcanza el límite
+    template <class F>
+    auto submit(F&& f) -> std::future<decltype(f())> {
+        using R = decltype(f());
+        auto task = std::make_shared<std::packaged_task<R()>>(std::forward<F>(f));
+        std::future<R> result = task->get_future();
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            notFull.wait(lock, [this] { return stopping || queue.size() < queueLimit; });
+            queue.emplace_back([task] { (*task)(); });
+        }
+        notEmpty.notify_one();
+        return result;
+    }
+
+    size_t threadCount() const { return workers.size(); }
+
+    size_t pending() {
+        std::lock_guard<std::mutex> lock(mtx);
+        return queue.size();
+    }
+};
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+#include "ollama_reply.hpp"
+
+// Perfil de rendimiento por modelo: se barre concurrencia x num_predict y de cada respuesta se
+// guardan los contadores que devuelve Ollama (load/prompt_eval/eval, en nanosegundos) junto con
+// la latencia vista por el cliente. De ahí salen tokens/s de prompt y de generación, el tiempo
+// fuera del modelo (cliente + red + cola) y el codo de la curva de throughput.
+const size_t PROFILE_DEFAULT_ROUNDS = 2;            // Peticiones por celda = rondas x concurrencia
+const double PROFILE_KNEE_EFFICIENCY = 0.25;        // Subir de nivel debe dar >= 25% de lo ideal
+const char* const PROFILE_DEFAULT_CONCURRENCY = "1,2,4,8";
+const char* const PROFILE_DEFAULT_NUM_PREDICT = "32,128";
+const char* const PROFILE_DEFAULT_PROMPT = "Explica qué es un puntero en C++ con un ejemplo corto.";
+
+// "1,2,4,8" -> {1, 2, 4, 8} ordenado y sin repetidos; false si algún valor no es un entero > 0
+inline bool parseCountList(const std::string& text, std::vector<long>& out) {
+    out.clear();
+    size_t start = 0;
+    while (start <= text.size()) {
+        size_t comma = text.find(',', start);
+        std::string item = text.substr(start, comma == std::string::npos ? std::string::npos : comma - start);
+        char* end = nullptr;
+        long n = std::strtol(item.c_str(), &end, 10);
+        if (item.empty() || *end != '\0' || n <= 0) {
+            return false;
+        }
+        out.push_back(n);
+        if (comma == std::string::npos) {
+            break;
+        }
+        start = comma + 1;
+    }
+    std::sort(out.begin(), out.end());
+    out.erase(std::unique(out.begin(), out.end()), out.end());
+    return !out.empty();
+}
+
+// Una petición medida: latencia del cliente y contadores del servidor
+struct ProfileSample {
+    bool ok = false;
+    long long wallUs = 0;
+    long long totalNs = 0;
+    long long loadNs = 0;
+    long long promptEvalCount = 0;
+    long long promptEvalNs = 0;
+    long long evalCount = 0;
+    long long evalNs = 0;
+};
+
+inline ProfileSample profileSample(const GenerateReply& r, long long wallUs) {
+    ProfileSample s;
+    s.ok = r.ok;
+    s.wallUs = wallUs;
+    s.totalNs = r.totalDuration;
+    s.loadNs = r.loadDuration;
+    s.promptEvalCount = r.promptEvalCount;
+    s.promptEvalNs = r.promptEvalDuration;
+    s.evalCount = r.evalCount;
+    s.evalNs = r.evalDuration;
+    return s;
+}
+
+// Resumen de una celda (modelo, num_predict, concurrencia)
+struct ProfileCell {
+    long concurrency = 0;
+    long numPredict = 0;
+    size_t requests = 0;
+    size_t errors = 0;
+    long long wallUs = 0;     // Duración de la celda entera
+    double genTps = 0;        // Tokens generados por todas las peticiones / duración de la celda
+    double streamTps = 0;     // eval_count / eval_duration: velocidad de un solo flujo
+    double promptTps = 0;     // prompt_eval_count / prompt_eval_duration (0 si el servidor no lo da)
+    double p50Ms = 0;         // Latencia por petición vista por el cliente
+    double p95Ms = 0;
+    double overheadMs = 0;    // p50 de latencia - total_duration: cliente, red y cola del servidor
+    double loadMs = 0;        // Mayor load_duration de la celda (> 0: el modelo se recargó)
+};
+
+inline double profilePercentile(std::vector<double>& values, double q) {
+    if (values.empty()) {
+        return 0;
+    }
+    std::sort(values.begin(), values.end());
+    size_t idx = static_cast<size_t>(q * static_cast<double>(values.size() - 1) + 0.5);
+    return values[std::min(idx, values.size() - 1)];
+}
+
+inline ProfileCell summarizeCell(long concurrency, long numPredict, const std::vector<ProfileSample>& samples,
+                                 long long wallUs) {
+    ProfileCell cell;
+    cell.concurrency = concurrency;
+    cell.numPredict = numPredict;
+    cell.requests = samples.size();
+    cell.wallUs = wallUs;
+    long long evalCount = 0, evalNs = 0, promptCount = 0, promptNs = 0, loadNs = 0;
+    std::vector<double> latencies, overheads;
+    for (const auto& s : samples) {
+        if (!s.ok) {
+            cell.errors++;
+            continue;
+        }
+        evalCount += s.evalCount;
+        evalNs += s.evalNs;
+        promptCount += s.promptEvalCount;
+        promptNs += s.promptEvalNs;
+        loadNs = std::max(loadNs, s.loadNs);
+        latencies.push_back(s.wallUs / 1000.0);
+        overheads.push_back(std::max(0.0, (s.wallUs * 1000.0 - static_cast<double>(s.totalNs)) / 1e6));
+    }
+    if (wallUs > 0) {
+        cell.genTps = evalCount * 1e6 / static_cast<double>(wallUs);
+    }
+    if (evalNs > 0) {
+        cell.streamTps = evalCount * 1e9 / static_cast<double>(evalNs);
+    }
+    if (promptNs > 0) {
+        cell.promptTps = promptCount * 1e9 / static_cast<double>(promptNs);
+    }
+    cell.loadMs = loadNs / 1e6;
+    cell.p50Ms = profilePercentile(latencies, 0.50);
+    cell.p95Ms = profilePercentile(latencies, 0.95);
+    cell.overheadMs = profilePercentile(overheads, 0.50);
+    return cell;
+}
+
+// Codo de la curva de throughput: el primer nivel desde el que pasar al siguiente da menos de
+// PROFILE_KNEE_EFFICIENCY de la mejora lineal (x2 de concurrencia -> +25% de tokens/s o menos).
+// 'cells' en orden de concurrencia creciente. Sin codo se devuelve el último y 'saturated' = false.
+inline size_t throughputKnee(const std::vector<ProfileCell>& cells, bool& saturated) {
+    saturated = false;
+    if (cells.empty()) {
+        return 0;
+    }
+    for (size_t i = 0; i + 1 < cells.size(); ++i) {
+        const ProfileCell& a = cells[i];
+        const ProfileCell& b = cells[i + 1];
+        if (a.genTps <= 0) {
+            continue;
+        }
+        double ideal = static_cast<double>(b.concurrency) / a.concurrency - 1;
+        double gain = b.genTps / a.genTps - 1;
+        if (gain < PROFILE_KNEE_EFFICIENCY * ideal) {
+            saturated = true;
+            return i;
+        }
+    }
+    return cells.size() - 1;
+}
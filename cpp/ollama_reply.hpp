@@ -0,0 +1,441 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <charconv>
+
+// Respuesta de /api/generate reducida a lo que usa el cliente.
+// El texto se guarda una sola vez y se comparte (cache, ask, askAsync) sin copiar.
+struct GenerateReply {
+    std::shared_ptr<const std::string> text;
+    std::string error;              // Campo "error" del servidor o fallo de transporte/formato
+    bool ok = false;                // Cuerpo válido y sin "error"
+    bool done = false;
+    long long totalDuration = 0;    // Nanosegundos, como los reporta Ollama
+    long long loadDuration = 0;
+    long long promptEvalCount = 0;
+    long long promptEvalDuration = 0;
+    long long evalCount = 0;
+    long long evalDuration = 0;
+
+    std::string_view response() const {
+        return text ? std::string_view(*text) : std::string_view();
+    }
+};
+
+// Escáner JSON en el sitio: recorre el cuerpo una vez, decodifica solo los campos
+// pedidos y salta el resto (p. ej. el array 'context') sin reservar memoria.
+class ReplyScanner {
+private:
+    const char* p;
+    const char* end;
+    std::vector<int32_t>* context; // Destino de 'context' (nullptr = saltarlo)
+    std::vector<float>* embeddings = nullptr; // Destino de 'embeddings' (/api/embed), filas contiguas
+    size_t* embedRows = nullptr;
+    size_t* embedDim = nullptr;
+
+    void skipWs() {
+        while (p < end && (*p == ' ' || *p == '\n' || *p == '\r' || *p == '\t')) {
+            ++p;
+        }
+    }
+
+    bool expect(char c) {
+        skipWs();
+        if (p >= end || *p != c) {
+            return false;
+        }
+        ++p;
+        return true;
+    }
+
+    // Saltar un string (p apunta a la comilla inicial)
+    bool skipString() {
+        ++p;
+        while (p < end) {
+            const char* q = static_cast<const char*>(std::memchr(p, '"', end - p));
+            if (!q) {
+                return false;
+            }
+            // Contar barras previas: comilla escapada si el número es impar
+            const char* b = q;
+            while (b > p && b[-1] == '\\') {
+                --b;
+            }
+            p = q + 1;
+            if (((q - b) & 1) == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Saltar cualquier valor; arrays y objetos por profundidad, sin recursión
+    bool skipValue() {
+        skipWs();
+        if (p >= end) {
+            return false;
+        }
+        if (*p == '"') {
+            return skipString();
+        }
+        if (*p != '[' && *p != '{') {
+            while (p < end && *p != ',' && *p != '}' && *p != ']' &&
+                   *p != ' ' && *p != '\n' && *p != '\r' && *p != '\t') {
+                ++p;
+            }
+            return true;
+        }
+        int depth = 0;
+        while (p < end) {
+            char c = *p;
+            if (c == '"') {
+                if (!skipString()) {
+                    return false;
+                }
+                continue;
+            }
+            if (c == '[' || c == '{') {
+                depth++;
+            } else if (c == ']' || c == '}') {
+                depth--;
+                if (depth == 0) {
+                    ++p;
+                    return true;
+                }
+            }
+            ++p;
+        }
+        return false;
+    }
+
+    static int hexValue(char c) {
+        if (c >= '0' && c <= '9') {
+            return c - '0';
+        }
+        if (c >= 'a' && c <= 'f') {
+            return c - 'a' + 10;
+        }
+        if (c >= 'A' && c <= 'F') {
+            return c - 'A' + 10;
+        }
+        return -1;
+    }
+
+    bool readHex4(unsigned& cp) {
+        if (end - p < 4) {
+            return false;
+        }
+        cp = 0;
+        for (int i = 0; i < 4; ++i) {
+            int v = hexValue(p[i]);
+            if (v < 0) {
+                return false;
+            }
+            cp = (cp << 4) | static_cast<unsigned>(v);
+        }
+        p += 4;
+        return true;
+    }
+
+    static void appendUtf8(std::string& out, unsigned cp) {
+        if (cp < 0x80) {
+            out += static_cast<char>(cp);
+        } else if (cp < 0x800) {
+            out += static_cast<char>(0xC0 | (cp >> 6));
+            out += static_cast<char>(0x80 | (cp & 0x3F));
+        } else if (cp < 0x10000) {
+            out += static_cast<char>(0xE0 | (cp >> 12));
+            out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (cp & 0x3F));
+        } else {
+            out += static_cast<char>(0xF0 | (cp >> 18));
+            out += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+            out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (cp & 0x3F));
+        }
+    }
+
+    // Decodificar un string JSON en 'out' (copia tramos enteros entre escapes)
+    bool readString(std::string& out) {
+        out.clear();
+        if (!expect('"')) {
+            return false;
+        }
+        while (p < end) {
+            const char* run = p;
+            while (p < end && *p != '"' && *p != '\\') {
+                ++p;
+            }
+            out.append(run, p - run);
+            if (p >= end) {
+                return false;
+            }
+            if (*p == '"') {
+                ++p;
+                return true;
+            }
+            ++p; // barra invertida
+            if (p >= end) {
+                return false;
+            }
+            char c = *p++;
+            switch (c) {
+                case '"': out += '"'; break;
+                case '\\': out += '\\'; break;
+                case '/': out += '/'; break;
+                case 'b': out += '\b'; break;
+                case 'f': out += '\f'; break;
+                case 'n': out += '\n'; break;
+                case 'r': out += '\r'; break;
+                case 't': out += '\t'; break;
+                case 'u': {
+                    unsigned cp;
+                    if (!readHex4(cp)) {
+                        return false;
+                    }
+                    // Par sustituto UTF-16 -> un solo code point
+                    if (cp >= 0xD800 && cp <= 0xDBFF && end - p >= 6 && p[0] == '\\' && p[1] == 'u') {
+                        p += 2;
+                        unsigned low;
+                        if (!readHex4(low)) {
+                            return false;
+                        }
+                        if (low >= 0xDC00 && low <= 0xDFFF) {
+                            cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                        } else {
+                            appendUtf8(out, 0xFFFD);
+                            cp = low;
+                        }
+                    }
+                    appendUtf8(out, cp);
+                    break;
+                }
+                default:
+                    return false;
+            }
+        }
+        return false;
+    }
+
+    bool readInt(long long& v) {
+        skipWs();
+        bool negative = p < end && *p == '-';
+        if (negative) {
+            ++p;
+        }
+        if (p >= end || *p < '0' || *p > '9') {
+            return false;
+        }
+        v = 0;
+        while (p < end && *p >= '0' && *p <= '9') {
+            v = v * 10 + (*p - '0');
+            ++p;
+        }
+        if (negative) {
+            v = -v;
+        }
+        // Ignorar parte decimal/exponente si la hubiera
+        while (p < end && (*p == '.' || *p == 'e' || *p == 'E' || *p == '+' || *p == '-' ||
+                           (*p >= '0' && *p <= '9'))) {
+            ++p;
+        }
+        return true;
+    }
+
+    // Array de enteros (tokens de 'context') directamente al vector, sin DOM
+    bool readIntArray(std::vector<int32_t>& out) {
+        out.clear();
+        if (!expect('[')) {
+            return false;
+        }
+        skipWs();
+        if (p < end && *p == ']') {
+            ++p;
+            return true;
+        }
+        while (true) {
+            long long v;
+            if (!readInt(v)) {
+                return false;
+            }
+            out.push_back(static_cast<int32_t>(v));
+            skipWs();
+            if (p < end && *p == ',') {
+                ++p;
+                continue;
+            }
+            return expect(']');
+        }
+    }
+
+    // Matriz de floats ([[...],[...]]) aplanada en 'out'; todas las filas con la misma dimensión
+    bool readFloatMatrix(std::vector<float>& out, size_t& rows, size_t& dim) {
+        out.clear();
+        rows = 0;
+        dim = 0;
+        if (!expect('[')) {
+            return false;
+        }
+        skipWs();
+        if (p < end && *p == ']') {
+            ++p;
+            return true;
+        }
+        while (true) {
+            if (!expect('[')) {
+                return false;
+            }
+            size_t before = out.size();
+            skipWs();
+            while (p < end && *p != ']') {
+                float v;
+                std::from_chars_result res = std::from_chars(p, end, v);
+                if (res.ec != std::errc()) {
+                    return false;
+                }
+                p = res.ptr;
+                out.push_back(v);
+                skipWs();
+                if (p < end && *p == ',') {
+                    ++p;
+                    skipWs();
+                }
+            }
+            if (!expect(']')) {
+                return false;
+            }
+            size_t n = out.size() - before;
+            if (rows == 0) {
+                dim = n;
+                out.reserve(dim * 16);
+            } else if (n != dim) {
+                return false;
+            }
+            rows++;
+            skipWs();
+            if (p < end && *p == ',') {
+                ++p;
+                continue;
+            }
+            return expect(']');
+        }
+    }
+
+    bool readBool(bool& v) {
+        skipWs();
+        if (end - p >= 4 && std::memcmp(p, "true", 4) == 0) {
+            v = true;
+            p += 4;
+            return true;
+        }
+        if (end - p >= 5 && std::memcmp(p, "false", 5) == 0) {
+            v = false;
+            p += 5;
+            return true;
+        }
+        return skipValue();
+    }
+
+    // Clave cruda (sin decodificar); las claves que nos interesan no llevan escapes
+    bool readKey(const char*& key, size_t& keyLen) {
+        if (!expect('"')) {
+            return false;
+        }
+        key = p;
+        while (p < end && *p != '"') {
+            if (*p == '\\') {
+                ++p;
+            }
+            ++p;
+        }
+        if (p >= end) {
+            return false;
+        }
+        keyLen = p - key;
+        ++p;
+        return expect(':');
+    }
+
+    static bool keyIs(const char* key, size_t len, const char* name) {
+        return std::strlen(name) == len && std::memcmp(key, name, len) == 0;
+    }
+
+public:
+    ReplyScanner(const char* data, size_t n, std::vector<int32_t>* ctx = nullptr)
+        : p(data), end(data + n), context(ctx) {}
+
+    // Decodificar también 'embeddings' (respuesta de /api/embed)
+    void captureEmbeddings(std::vector<float>* out, size_t* rows, size_t* dim) {
+        embeddings = out;
+        embedRows = rows;
+        embedDim = dim;
+    }
+
+    // Extraer response, done, error, contadores y (si se pidió) context; 'text' recibe el texto
+    bool scan(std::string& text, GenerateReply& meta) {
+        text.clear();
+        if (!expect('{')) {
+            return false;
+        }
+        skipWs();
+        if (p < end && *p == '}') {
+            return true;
+        }
+        while (true) {
+            const char* key;
+            size_t len;
+            if (!readKey(key, len)) {
+                return false;
+            }
+            bool ok;
+            if (keyIs(key, len, "response")) {
+                ok = readString(text);
+            } else if (keyIs(key, len, "done")) {
+                ok = readBool(meta.done);
+            } else if (keyIs(key, len, "error")) {
+                ok = readString(meta.error);
+            } else if (keyIs(key, len, "total_duration")) {
+                ok = readInt(meta.totalDuration);
+            } else if (keyIs(key, len, "load_duration")) {
+                ok = readInt(meta.loadDuration);
+            } else if (keyIs(key, len, "prompt_eval_count")) {
+                ok = readInt(meta.promptEvalCount);
+            } else if (keyIs(key, len, "prompt_eval_duration")) {
+                ok = readInt(meta.promptEvalDuration);
+            } else if (keyIs(key, len, "eval_count")) {
+                ok = readInt(meta.evalCount);
+            } else if (keyIs(key, len, "eval_duration")) {
+                ok = readInt(meta.evalDuration);
+            } else if (context && keyIs(key, len, "context")) {
+                ok = readIntArray(*context);
+            } else if (embeddings && keyIs(key, len, "embeddings")) {
+                ok = readFloatMatrix(*embeddings, *embedRows, *embedDim);
+            } else {
+                ok = skipValue();
+            }
+            if (!ok) {
+                return false;
+            }
+            skipWs();
+            if (p < end && *p == ',') {
+                ++p;
+                continue;
+            }
+            return expect('}');
+        }
+    }
+};
+
+// Escanear un cuerpo completo de /api/generate; el texto pasa a un buffer compartido
+inline GenerateReply scanGenerateReply(const std::string& body, std::vector<int32_t>* context = nullptr) {
+    GenerateReply reply;
+    std::string text;
+    reply.ok = ReplyScanner(body.data(), body.size(), context).scan(text, reply) && reply.error.empty();
+    reply.text = std::make_shared<const std::string>(std::move(text));
+    return reply;
+}
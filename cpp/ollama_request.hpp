@@ -0,0 +1,244 @@
+#pragma once
+
+#include <string>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+#if defined(__x86_64__) && defined(__SSE2__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define OLLAMA_JSON_AVX2 1
+#else
+#define OLLAMA_JSON_AVX2 0
+#endif
+#if defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// Construcción del cuerpo de /api/generate sin DOM: la parte constante (modelo, opciones,
+// stream) se serializa una vez por plantilla y en cada petición solo se escapa el prompt
+// en un buffer reutilizado. Con el buffer ya crecido, construir un cuerpo no reserva memoria.
+
+// Holgura al dimensionar la salida: 1 byte extra cada JSON_ESCAPE_HEADROOM de entrada
+const size_t JSON_ESCAPE_HEADROOM = 16;
+
+// Índice del bit menos significativo (mask != 0)
+inline int jsonLowestBit(unsigned mask) {
+#if defined(_MSC_VER) && !defined(__clang__)
+    unsigned long idx;
+    _BitScanForward(&idx, mask);
+    return static_cast<int>(idx);
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+
+// Bytes que necesitan escape en un string JSON: comilla, barra invertida y controles < 0x20
+inline bool jsonNeedsEscape(unsigned char c) {
+    return c < 0x20 || c == '"' || c == '\\';
+}
+
+// Posición del primer byte de s[0..n) que necesita escape, o n si no hay ninguno.
+// Versión escalar: referencia y cola de las vectoriales.
+inline size_t jsonEscapeScanScalar(const char* s, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        if (jsonNeedsEscape(static_cast<unsigned char>(s[i]))) {
+            return i;
+        }
+    }
+    return n;
+}
+
+#if defined(__SSE2__) || defined(_M_X64)
+// SSE2 (base de x86-64): 16 bytes por comparación. c < 0x20 sin signo <=> max(c, 0x1f) == 0x1f
+inline size_t jsonEscapeScanSse2(const char* s, size_t n) {
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i slash = _mm_set1_epi8('\\');
+    const __m128i ctrl = _mm_set1_epi8(0x1f);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+        __m128i hit = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, slash)),
+                                   _mm_cmpeq_epi8(_mm_max_epu8(v, ctrl), ctrl));
+        int mask = _mm_movemask_epi8(hit);
+        if (mask != 0) {
+            return i + static_cast<size_t>(jsonLowestBit(static_cast<unsigned>(mask)));
+        }
+    }
+    return i + jsonEscapeScanScalar(s + i, n - i);
+}
+#endif
+
+#if OLLAMA_JSON_AVX2
+// AVX2: 32 bytes por comparación. Se compila con target("avx2") y se elige en tiempo de
+// ejecución, así que el binario sigue funcionando en CPUs sin AVX2
+__attribute__((target("avx2"))) inline size_t jsonEscapeScanAvx2(const char* s, size_t n) {
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i slash = _mm256_set1_epi8('\\');
+    const __m256i ctrl = _mm256_set1_epi8(0x1f);
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + i));
+        __m256i hit = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, quote), _mm256_cmpeq_epi8(v, slash)),
+                                      _mm256_cmpeq_epi8(_mm256_max_epu8(v, ctrl), ctrl));
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(hit));
+        if (mask != 0) {
+            return i + static_cast<size_t>(jsonLowestBit(mask));
+        }
+    }
+    return i + jsonEscapeScanSse2(s + i, n - i);
+}
+#endif
+
+#if defined(__ARM_NEON) && defined(__aarch64__)
+// NEON: 16 bytes por comparación; la máscara se estrecha a 4 bits por byte (vshrn) para
+// localizar el primero con un ctz
+inline size_t jsonEscapeScanNeon(const char* s, size_t n) {
+    const uint8x16_t quote = vdupq_n_u8('"');
+    const uint8x16_t slash = vdupq_n_u8('\\');
+    const uint8x16_t ctrl = vdupq_n_u8(0x20);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        uint8x16_t v = vld1q_u8(reinterpret_cast<const uint8_t*>(s + i));
+        uint8x16_t hit = vorrq_u8(vorrq_u8(vceqq_u8(v, quote), vceqq_u8(v, slash)), vcltq_u8(v, ctrl));
+        uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(hit), 4)), 0);
+        if (mask != 0) {
+            return i + static_cast<size_t>(__builtin_ctzll(mask) >> 2);
+        }
+    }
+    return i + jsonEscapeScanScalar(s + i, n - i);
+}
+#endif
+
+// Variante más ancha disponible en esta CPU (se resuelve una vez)
+inline size_t jsonEscapeScan(const char* s, size_t n) {
+#if OLLAMA_JSON_AVX2
+    static const bool avx2 = __builtin_cpu_supports("avx2");
+    return avx2 ? jsonEscapeScanAvx2(s, n) : jsonEscapeScanSse2(s, n);
+#elif defined(__SSE2__) || defined(_M_X64)
+    return jsonEscapeScanSse2(s, n);
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    return jsonEscapeScanNeon(s, n);
+#else
+    return jsonEscapeScanScalar(s, n);
+#endif
+}
+
+inline const char* jsonEscapeIsa() {
+#if OLLAMA_JSON_AVX2
+    return __builtin_cpu_supports("avx2") ? "avx2" : "sse2";
+#elif defined(__SSE2__) || defined(_M_X64)
+    return "sse2";
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    return "neon";
+#else
+    return "escalar";
+#endif
+}
+
+typedef size_t (*JsonEscapeScan)(const char*, size_t);
+
+// Letra del escape corto de 'c' (\" \\ \n \r \t \b \f), o 0 si va como \u00XX
+inline char jsonShortEscape(unsigned char c) {
+    switch (c) {
+        case '"': return '"';
+        case '\\': return '\\';
+        case '\n': return 'n';
+        case '\r': return 'r';
+        case '\t': return 't';
+        case '\b': return 'b';
+        case '\f': return 'f';
+        default: return 0;
+    }
+}
+
+// Añadir 's' escapado como contenido de un string JSON (sin las comillas), en una pasada:
+// el escáner vectorial salta hasta el siguiente byte a escapar, el tramo limpio se copia de
+// una vez y el escape se escribe en el sitio. La salida se dimensiona antes con holgura para
+// los escapes y solo crece si no alcanza; UTF-8 pasa tal cual.
+inline void appendJsonEscaped(std::string& out, const char* s, size_t n, JsonEscapeScan scan = jsonEscapeScan) {
+    static const char hex[] = "0123456789abcdef";
+    size_t len = out.size();
+    out.resize(len + n + n / JSON_ESCAPE_HEADROOM + 8);
+    size_t i = 0;
+    while (i < n) {
+        size_t run = scan(s + i, n - i);
+        // Tramo + el escape más largo (6 bytes) + lo que falta sin escapar
+        if (len + run + 6 + (n - i - run) > out.size()) {
+            out.resize(std::max(out.size() * 2, len + (n - i) + 6));
+        }
+        char* p = &out[len];
+        std::memcpy(p, s + i, run);
+        i += run;
+        len += run;
+        if (i == n) {
+            break;
+        }
+        unsigned char c = static_cast<unsigned char>(s[i++]);
+        p += run;
+        char e = jsonShortEscape(c);
+        p[0] = '\\';
+        if (e) {
+            p[1] = e;
+            len += 2;
+        } else {
+            p[1] = 'u';
+            p[2] = '0';
+            p[3] = '0';
+            p[4] = hex[c >> 4];
+            p[5] = hex[c & 0xF];
+            len += 6;
+        }
+    }
+    out.resize(len);
+}
+
+inline void appendJsonEscaped(std::string& out, const std::string& s) {
+    appendJsonEscaped(out, s.data(), s.size());
+}
+
+// Plantilla de un cuerpo {"model":..,"stream":..,"options":{..},"prompt":".."} por
+// (modelo, opciones, stream). 'optionsJson' ya es JSON (p. ej. el dump() canónico).
+class RequestTemplate {
+private:
+    std::string head; // Todo hasta la comilla que abre el prompt
+
+public:
+    RequestTemplate() = default;
+
+    RequestTemplate(const std::string& model, const std::string& optionsJson, bool stream) {
+        head = "{\"model\":\"";
+        appendJsonEscaped(head, model);
+        head += stream ? "\",\"stream\":true" : "\",\"stream\":false";
+        if (!optionsJson.empty()) {
+            head += ",\"options\":";
+            head += optionsJson;
+        }
+        head += ",\"prompt\":\"";
+    }
+
+    bool empty() const { return head.empty(); }
+
+    // Cuerpo completo en 'out' (se reutiliza su capacidad)
+    void build(const char* prompt, size_t len, std::string& out) const {
+        out.assign(head);
+        appendJsonEscaped(out, prompt, len);
+        out.append("\"}", 2);
+    }
+
+    void build(const std::string& prompt, std::string& out) const {
+        build(prompt.data(), prompt.size(), out);
+    }
+
+    // Cuerpo en el buffer del hilo: válido hasta el siguiente render() en el mismo hilo
+    const std::string& render(const std::string& prompt) const {
+        thread_local std::string body;
+        build(prompt, body);
+        return body;
+    }
+};
@@ -0,0 +1,237 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstdint>
+
+// Clase de prioridad de una petición de generación: las interactivas (ask, fast, stream,
+// sesiones) pasan delante de las de lote (batch, warm)
+enum class Priority : int {
+    Interactive = 0,
+    Batch,
+    Count
+};
+
+const int PRIORITY_COUNT = static_cast<int>(Priority::Count);
+const long long SCHEDULER_AGING_MS = 5000;      // Una de lote que espera esto compite como interactiva
+const double DEFAULT_EVAL_MS_PER_TOKEN = 25.0;  // Estimación hasta la primera respuesta del modelo
+const double DEFAULT_PROMPT_MS_PER_TOKEN = 1.0;
+const double SCHEDULER_EWMA_ALPHA = 0.2;        // Peso de la última respuesta en la media de ms/token
+const size_t PROMPT_BYTES_PER_TOKEN = 4;        // Aproximación para estimar tokens del prompt
+
+inline const char* priorityName(Priority p) {
+    return p == Priority::Batch ? "batch" : "interactive";
+}
+
+// Planificador de peticiones delante de la capa HTTP: como mucho 'capacity' generaciones
+// en curso (lo que el servidor atiende a la vez); el resto espera aquí y no en la cola FIFO
+// de Ollama. Al liberarse un hueco:
+//   1. Clase: interactivas primero, salvo una de lote que ya envejeció (sin inanición)
+//   2. Modelo: turno rotatorio entre las colas por modelo de esa clase (reparto justo)
+//   3. Dentro de la cola: la de menor duración esperada (shortest job first), FIFO en empates
+// La duración esperada sale de num_predict y del tamaño del prompt por los ms/token que
+// reportó Ollama (eval_duration / eval_count) en las respuestas anteriores de cada modelo.
+class RequestScheduler {
+private:
+    struct Waiter {
+        double cost;
+        long long enqueuedMs;
+        uint64_t seq;
+        bool granted = false;
+        std::condition_variable wake;
+    };
+
+    struct ModelRates {
+        double evalMsPerToken = DEFAULT_EVAL_MS_PER_TOKEN;
+        double promptMsPerToken = DEFAULT_PROMPT_MS_PER_TOKEN;
+        bool evalSeen = false; // La primera medida reemplaza la estimación por defecto
+        bool promptSeen = false;
+    };
+
+    std::mutex mtx;
+    size_t capacity;
+    size_t running = 0;
+    size_t waiting = 0;
+    uint64_t nextSeq = 0;
+    std::map<std::string, std::vector<Waiter*>> queues[PRIORITY_COUNT];
+    std::string lastModel[PRIORITY_COUNT]; // Cursor del turno rotatorio por clase
+    std::unordered_map<std::string, ModelRates> rates;
+    unsigned long long granted[PRIORITY_COUNT] = {0, 0};
+    unsigned long long queued[PRIORITY_COUNT] = {0, 0};
+
+    static long long nowMs() {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // La de lote más antigua, si lleva esperando más de SCHEDULER_AGING_MS
+    bool agedBatch(long long now, std::string& model, size_t& index) {
+        bool found = false;
+        long long oldest = now - SCHEDULER_AGING_MS;
+        for (auto& q : queues[static_cast<int>(Priority::Batch)]) {
+            for (size_t i = 0; i < q.second.size(); ++i) {
+                if (q.second[i]->enqueuedMs <= oldest) {
+                    oldest = q.second[i]->enqueuedMs;
+                    model = q.first;
+                    index = i;
+                    found = true;
+                }
+            }
+        }
+        return found;
+    }
+
+    // Siguiente modelo con cola no vacía después del último atendido en esa clase
+    bool nextModel(int cls, std::string& model) {
+        auto& byModel = queues[cls];
+        if (byModel.empty()) {
+            return false;
+        }
+        auto it = byModel.upper_bound(lastModel[cls]);
+        model = it == byModel.end() ? byModel.begin()->first : it->first;
+        return true;
+    }
+
+    static size_t shortestJob(const std::vector<Waiter*>& q) {
+        size_t best = 0;
+        for (size_t i = 1; i < q.size(); ++i) {
+            if (q[i]->cost < q[best]->cost || (q[i]->cost == q[best]->cost && q[i]->seq < q[best]->seq)) {
+                best = i;
+            }
+        }
+        return best;
+    }
+
+    // Conceder huecos libres a los que esperan (con el mutex tomado)
+    void dispatchLocked() {
+        while (waiting > 0 && (capacity == 0 || running < capacity)) {
+            std::string model;
+            size_t index = 0;
+            int cls = static_cast<int>(Priority::Batch);
+            if (!agedBatch(nowMs(), model, index)) {
+                cls = queues[static_cast<int>(Priority::Interactive)].empty() ? static_cast<int>(Priority::Batch)
+                                                                               : static_cast<int>(Priority::Interactive);
+                nextModel(cls, model);
+                index = shortestJob(queues[cls][model]);
+            }
+            std::vector<Waiter*>& q = queues[cls][model];
+            Waiter* w = q[index];
+            q.erase(q.begin() + static_cast<long>(index));
+            if (q.empty()) {
+                queues[cls].erase(model);
+            }
+            lastModel[cls] = model;
+            waiting--;
+            running++;
+            w->granted = true;
+            w->wake.notify_one();
+        }
+    }
+
+public:
+    // capacity 0 = sin límite (el planificador no retiene nada)
+    explicit RequestScheduler(size_t slots) : capacity(slots) {}
+
+    RequestScheduler(const RequestScheduler&) = delete;
+    RequestScheduler& operator=(const RequestScheduler&) = delete;
+
+    void setCapacity(size_t slots) {
+        std::lock_guard<std::mutex> lock(mtx);
+        capacity = slots;
+        dispatchLocked();
+    }
+
+    // Duración esperada en ms de una generación de 'numPredict' tokens con un prompt de 'promptBytes'
+    double estimate(const std::string& model, int numPredict, size_t promptBytes) {
+        std::lock_guard<std::mutex> lock(mtx);
+        ModelRates r;
+        auto it = rates.find(model);
+        if (it != rates.end()) {
+            r = it->second;
+        }
+        return r.evalMsPerToken * (numPredict > 0 ? numPredict : 0) +
+               r.promptMsPerToken * static_cast<double>(promptBytes / PROMPT_BYTES_PER_TOKEN);
+    }
+
+    // Aprender ms/token de una respuesta (duraciones de Ollama en nanosegundos)
+    void observe(const std::string& model, long long evalCount, long long evalDurationNs,
+                 long long promptEvalCount, long long promptEvalDurationNs) {
+        std::lock_guard<std::mutex> lock(mtx);
+        ModelRates& r = rates[model];
+        if (evalCount > 0 && evalDurationNs > 0) {
+            double ms = evalDurationNs / 1e6 / evalCount;
+            r.evalMsPerToken = r.evalSeen ? r.evalMsPerToken + SCHEDULER_EWMA_ALPHA * (ms - r.evalMsPerToken) : ms;
+            r.evalSeen = true;
+        }
+        if (promptEvalCount > 0 && promptEvalDurationNs > 0) {
+            double ms = promptEvalDurationNs / 1e6 / promptEvalCount;
+            r.promptMsPerToken =
+                r.promptSeen ? r.promptMsPerToken + SCHEDULER_EWMA_ALPHA * (ms - r.promptMsPerToken) : ms;
+            r.promptSeen = true;
+        }
+    }
+
+    // Esperar un hueco. Sin cola y con hueco libre entra directamente
+    void acquire(const std::string& model, double cost, Priority priority) {
+        std::unique_lock<std::mutex> lock(mtx);
+        int cls = static_cast<int>(priority);
+        if (waiting == 0 && (capacity == 0 || running < capacity)) {
+            running++;
+            granted[cls]++;
+            return;
+        }
+        Waiter w;
+        w.cost = cost;
+        w.enqueuedMs = nowMs();
+        w.seq = nextSeq++;
+        queues[cls][model].push_back(&w);
+        waiting++;
+        queued[cls]++;
+        granted[cls]++;
+        w.wake.wait(lock, [&w] { return w.granted; });
+    }
+
+    void release() {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (running > 0) {
+            running--;
+        }
+        dispatchLocked();
+    }
+
+    size_t getCapacity() {
+        std::lock_guard<std::mutex> lock(mtx);
+        return capacity;
+    }
+
+    size_t waitingCount() {
+        std::lock_guard<std::mutex> lock(mtx);
+        return waiting;
+    }
+
+    // Peticiones concedidas y cuántas de ellas tuvieron que esperar, por clase
+    void counts(Priority p, unsigned long long& grantedOut, unsigned long long& queuedOut) {
+        std::lock_guard<std::mutex> lock(mtx);
+        grantedOut = granted[static_cast<int>(p)];
+        queuedOut = queued[static_cast<int>(p)];
+    }
+};
+
+// Hueco del planificador mientras dura una generación
+class SchedulerTicket {
+private:
+    RequestScheduler& scheduler;
+
+public:
+    SchedulerTicket(RequestScheduler& s, const std::string& model, double cost, Priority priority) : scheduler(s) {
+        scheduler.acquire(model, cost, priority);
+    }
+    ~SchedulerTicket() { scheduler.release(); }
+    SchedulerTicket(const SchedulerTicket&) = delete;
+    SchedulerTicket& operator=(const SchedulerTicket&) = delete;
+};
@@ -0,0 +1,179 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <shared_mutex>
+#include <mutex>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include "ollama_hash.hpp"
+
+// Segundo nivel del cache, en dos etapas:
+//   1. Normalización: espacios, mayúsculas y puntuación final no cambian la clave exacta.
+//   2. Similitud (opcional): el embedding de la pregunta se compara con los de las preguntas
+//      ya respondidas; por encima del umbral se sirve la respuesta guardada sin ir a la GPU.
+const size_t SEMANTIC_INDEX_MAX = 20000; // Vectores en memoria; al llenarse se reemplaza el más antiguo
+
+// OLLAMA_CACHE_NORMALIZE=0 vuelve a la clave byte a byte
+inline bool cacheNormalizeEnabled() {
+    static const bool enabled = [] {
+        const char* env = std::getenv("OLLAMA_CACHE_NORMALIZE");
+        return !(env && std::string(env) == "0");
+    }();
+    return enabled;
+}
+
+// OLLAMA_SEMANTIC_THRESHOLD: similitud coseno mínima (p. ej. 0.92); sin definir o 0 = desactivado
+inline float defaultSemanticThreshold() {
+    const char* env = std::getenv("OLLAMA_SEMANTIC_THRESHOLD");
+    if (!env || !*env) {
+        return 0.0f;
+    }
+    float t = std::strtof(env, nullptr);
+    return t > 0.0f && t <= 1.0f ? t : 0.0f;
+}
+
+// Forma canónica de un prompt para la clave del cache: sin espacios al principio ni al final,
+// cada racha de espacios/saltos como un espacio, minúsculas (ASCII y Latin-1 en UTF-8),
+// sin ¿¡ iniciales ni .,;:!? finales. El prompt que se envía a Ollama no cambia.
+inline std::string normalizePrompt(const std::string& prompt) {
+    std::string out;
+    out.reserve(prompt.size());
+    bool pendingSpace = false;
+    for (size_t i = 0; i < prompt.size(); ++i) {
+        unsigned char c = static_cast<unsigned char>(prompt[i]);
+        if (c == ' ' || c == '\t' || c == '\n' || c == '\r') {
+            pendingSpace = !out.empty();
+            continue;
+        }
+        // ¿ y ¡ iniciales (C2 BF, C2 A1)
+        if (out.empty() && c == 0xC2 && i + 1 < prompt.size() &&
+            (static_cast<unsigned char>(prompt[i + 1]) == 0xBF || static_cast<unsigned char>(prompt[i + 1]) == 0xA1)) {
+            ++i;
+            continue;
+        }
+        if (pendingSpace) {
+            out += ' ';
+            pendingSpace = false;
+        }
+        if (c >= 'A' && c <= 'Z') {
+            out += static_cast<char>(c + 32);
+        } else if (c == 0xC3 && i + 1 < prompt.size()) {
+            // À..Þ (salvo ×) -> à..þ: Á, É, Ñ, Ü...
+            unsigned char next = static_cast<unsigned char>(prompt[i + 1]);
+            out += static_cast<char>(c);
+            out += static_cast<char>(next >= 0x80 && next <= 0x9E && next != 0x97 ? next + 0x20 : next);
+            ++i;
+        } else {
+            out += static_cast<char>(c);
+        }
+    }
+    while (!out.empty()) {
+        char c = out.back();
+        if (c == '.' || c == ',' || c == ';' || c == ':' || c == '!' || c == '?' || c == ' ') {
+            out.pop_back();
+        } else {
+            break;
+        }
+    }
+    return out;
+}
+
+// Producto escalar con 8 acumuladores independientes: sin dependencia entre sumas,
+// el compilador lo vectoriza con -O2 (SSE/AVX/NEON) sin necesitar -ffast-math
+inline float dotProduct(const float* a, const float* b, size_t n) {
+    float acc[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+    size_t blocked = n - n % 8;
+    for (size_t i = 0; i < blocked; i += 8) {
+        for (int k = 0; k < 8; ++k) {
+            acc[k] += a[i + k] * b[i + k];
+        }
+    }
+    float sum = ((acc[0] + acc[1]) + (acc[2] + acc[3])) + ((acc[4] + acc[5]) + (acc[6] + acc[7]));
+    for (size_t i = blocked; i < n; ++i) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+// Índice plano de vectores unitarios en memoria contigua: búsqueda = un recorrido de
+// productos escalares (coseno), suficiente para decenas de miles de preguntas.
+// Cada vector lleva el 'scope' (modelo + opciones) y la clave del cache de su respuesta.
+class SemanticIndex {
+private:
+    std::shared_mutex mutex;
+    size_t dim = 0;
+    std::vector<float> vectors;
+    std::vector<uint64_t> scopes;
+    std::vector<CacheKey> keys;
+    size_t nextSlot = 0;
+
+public:
+    // Añadir (o reemplazar el más antiguo si está lleno). Otra dimensión reinicia el índice:
+    // cambió el modelo de embeddings.
+    void add(uint64_t scope, const float* v, size_t d, const CacheKey& key) {
+        float norm = std::sqrt(dotProduct(v, v, d));
+        if (d == 0 || norm == 0.0f) {
+            return;
+        }
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        if (d != dim) {
+            dim = d;
+            vectors.clear();
+            scopes.clear();
+            keys.clear();
+            nextSlot = 0;
+        }
+        size_t slot = scopes.size();
+        if (slot >= SEMANTIC_INDEX_MAX) {
+            slot = nextSlot;
+            nextSlot = (nextSlot + 1) % SEMANTIC_INDEX_MAX;
+        } else {
+            vectors.resize((slot + 1) * dim);
+            scopes.push_back(scope);
+            keys.push_back(key);
+        }
+        float* row = vectors.data() + slot * dim;
+        for (size_t i = 0; i < dim; ++i) {
+            row[i] = v[i] / norm;
+        }
+        scopes[slot] = scope;
+        keys[slot] = key;
+    }
+
+    // Vecino más parecido del mismo scope con similitud >= threshold
+    bool nearest(uint64_t scope, const float* v, size_t d, float threshold, CacheKey& key, float& score) {
+        float norm = std::sqrt(dotProduct(v, v, d));
+        if (norm == 0.0f) {
+            return false;
+        }
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        if (d != dim) {
+            return false;
+        }
+        float best = threshold * norm;
+        long bestSlot = -1;
+        for (size_t i = 0; i < scopes.size(); ++i) {
+            if (scopes[i] != scope) {
+                continue;
+            }
+            float s = dotProduct(vectors.data() + i * dim, v, dim);
+            if (s >= best) {
+                best = s;
+                bestSlot = static_cast<long>(i);
+            }
+        }
+        if (bestSlot < 0) {
+            return false;
+        }
+        key = keys[bestSlot];
+        score = best / norm;
+        return true;
+    }
+
+    size_t size() {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        return scopes.size();
+    }
+};
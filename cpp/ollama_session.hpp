@@ -0,0 +1,148 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+// Formato binario de una sesión (little-endian):
+//   [magic 8][version u32][turns u32][modelLen u32][keepAliveLen u32][tokens u32]
+//   [model][keepAlive][context: tokens x int32]
+const char SESSION_FILE_MAGIC[8] = {'O', 'L', 'L', 'S', 'E', 'S', 'S', '1'};
+const uint32_t SESSION_FILE_VERSION = 1;
+const uint32_t SESSION_MAX_TOKENS = 1 << 24;   // Límite de cordura al leer archivos dañados
+const std::string DEFAULT_KEEP_ALIVE = "30m"; // Mantener el modelo (y su KV) cargado entre turnos
+
+// Conversación multi-turno: 'context' son los tokens que Ollama devuelve en cada respuesta
+struct Session {
+    std::string name;
+    std::string model;
+    std::string keepAlive = DEFAULT_KEEP_ALIVE;
+    std::vector<int32_t> context;
+    uint32_t turns = 0;
+};
+
+// Directorio de sesiones (OLLAMA_SESSION_DIR o ~/.ollama_sessions)
+inline std::string defaultSessionDir() {
+    const char* env = std::getenv("OLLAMA_SESSION_DIR");
+    if (env && *env) {
+        return env;
+    }
+#ifdef _WIN32
+    const char* home = std::getenv("USERPROFILE");
+#else
+    const char* home = std::getenv("HOME");
+#endif
+    if (home && *home) {
+        return std::string(home) + "/.ollama_sessions";
+    }
+    return "ollama_sessions";
+}
+
+inline std::string sessionPath(const std::string& name) {
+    return defaultSessionDir() + "/" + name + ".bin";
+}
+
+inline void writeU32(std::ofstream& out, uint32_t v) {
+    unsigned char b[4] = {
+        static_cast<unsigned char>(v), static_cast<unsigned char>(v >> 8),
+        static_cast<unsigned char>(v >> 16), static_cast<unsigned char>(v >> 24)
+    };
+    out.write(reinterpret_cast<const char*>(b), sizeof(b));
+}
+
+inline bool readU32(std::ifstream& in, uint32_t& v) {
+    unsigned char b[4];
+    if (!in.read(reinterpret_cast<char*>(b), sizeof(b))) {
+        return false;
+    }
+    v = static_cast<uint32_t>(b[0]) | (static_cast<uint32_t>(b[1]) << 8) |
+        (static_cast<uint32_t>(b[2]) << 16) | (static_cast<uint32_t>(b[3]) << 24);
+    return true;
+}
+
+// Cargar una sesión guardada; false si no existe o el archivo no es válido
+inline bool loadSession(const std::string& path, Session& s) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in.is_open()) {
+        return false;
+    }
+    char magic[8];
+    uint32_t version, modelLen, keepAliveLen, tokens;
+    if (!in.read(magic, sizeof(magic)) || std::memcmp(magic, SESSION_FILE_MAGIC, sizeof(magic)) != 0 ||
+        !readU32(in, version) || version != SESSION_FILE_VERSION ||
+        !readU32(in, s.turns) || !readU32(in, modelLen) || !readU32(in, keepAliveLen) || !readU32(in, tokens)) {
+        return false;
+    }
+    if (modelLen > 1024 || keepAliveLen > 64 || tokens > SESSION_MAX_TOKENS) {
+        return false;
+    }
+    s.model.resize(modelLen);
+    s.keepAlive.resize(keepAliveLen);
+    if (!in.read(&s.model[0], modelLen) || !in.read(&s.keepAlive[0], keepAliveLen)) {
+        return false;
+    }
+    std::string raw(static_cast<size_t>(tokens) * 4, '\0');
+    if (!in.read(&raw[0], raw.size())) {
+        return false;
+    }
+    s.context.resize(tokens);
+    const unsigned char* b = reinterpret_cast<const unsigned char*>(raw.data());
+    for (uint32_t i = 0; i < tokens; ++i, b += 4) {
+        s.context[i] = static_cast<int32_t>(static_cast<uint32_t>(b[0]) | (static_cast<uint32_t>(b[1]) << 8) |
+                                            (static_cast<uint32_t>(b[2]) << 16) | (static_cast<uint32_t>(b[3]) << 24));
+    }
+    return true;
+}
+
+// Guardar en un archivo temporal y renombrar: nunca queda una sesión a medio escribir
+inline bool saveSession(const std::string& path, const Session& s) {
+    std::string dir = path.substr(0, path.find_last_of("/\\"));
+    if (!dir.empty() && dir != path) {
+#ifdef _WIN32
+        _mkdir(dir.c_str());
+#else
+        mkdir(dir.c_str(), 0755);
+#endif
+    }
+    std::string tmp = path + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) {
+            return false;
+        }
+        out.write(SESSION_FILE_MAGIC, sizeof(SESSION_FILE_MAGIC));
+        writeU32(out, SESSION_FILE_VERSION);
+        writeU32(out, s.turns);
+        writeU32(out, static_cast<uint32_t>(s.model.size()));
+        writeU32(out, static_cast<uint32_t>(s.keepAlive.size()));
+        writeU32(out, static_cast<uint32_t>(s.context.size()));
+        out.write(s.model.data(), s.model.size());
+        out.write(s.keepAlive.data(), s.keepAlive.size());
+        std::string raw(s.context.size() * 4, '\0');
+        for (size_t i = 0; i < s.context.size(); ++i) {
+            uint32_t v = static_cast<uint32_t>(s.context[i]);
+            raw[4 * i] = static_cast<char>(v);
+            raw[4 * i + 1] = static_cast<char>(v >> 8);
+            raw[4 * i + 2] = static_cast<char>(v >> 16);
+            raw[4 * i + 3] = static_cast<char>(v >> 24);
+        }
+        out.write(raw.data(), raw.size());
+        if (!out) {
+            return false;
+        }
+    }
+#ifdef _WIN32
+    std::remove(path.c_str());
+#endif
+    return std::rename(tmp.c_str(), path.c_str()) == 0;
+}
@@ -1,137 +1,643 @@
 #!/usr/bin/env python3
 """
 Ollama Cache System - Improve performance with response caching
+
+Reads and writes the same memory-mapped cache file as the C++ clients
+(cpp/ollama_cache.hpp, format v6), so a prompt answered by one tool is a
+cache hit for the other. Layout, all little-endian:
+
+    [header 64 B][16 shard headers 64 B][16 x slotsPerShard slots 48 B][append-only data]
+
+Each shard is an open-addressing table keyed by a 128-bit fingerprint
+(truncated SHA-256 of model, system, prompt and canonical options). Processes
+coordinate with 1-byte file locks: byte 0 = map (shared to read/insert,
+exclusive to grow, compact or clear), byte 1 = data region, byte 2 + n = shard n.
+Statistics come from the shard header counters, not from scanning entries.
 """
 
 import hashlib
 import json
+import mmap
 import os
+import struct
+import threading
 import time
-from datetime import datetime, timedelta
+import zlib
+from contextlib import contextmanager
 from typing import Optional, Dict, Any
 
+if os.name == "nt":
+    import msvcrt
+    fcntl = None
+else:
+    import fcntl
+    msvcrt = None
+
+try:
+    import lz4.block as lz4_block
+except ImportError:
+    lz4_block = None
+
+try:
+    import zstandard
+except ImportError:
+    zstandard = None
+
+CACHE_FILE_MAGIC = b"OLLCACHE"
+CACHE_FILE_VERSION = 6
+CACHE_SHARDS = 16
+CACHE_DATA_INITIAL = 1 << 20
+CACHE_DEFAULT_MAX_BYTES = 64 << 20
+CACHE_DEFAULT_ENTRIES = 1000
+CACHE_SWEEP_PER_INSERT = 8
+
+CACHE_LOCK_MAP = 0
+CACHE_LOCK_DATA = 1
+CACHE_LOCK_SHARD = 2
+
+SLOT_EMPTY = 0
+SLOT_USED = 1
+SLOT_DELETED = 2
+
+CODEC_NONE = 0
+CODEC_ZLIB = 1
+CODEC_LZ4 = 2
+CODEC_ZSTD = 3
+CODEC_MIN_SIZE = 512
+
+# struct CacheFileHeader / CacheShardHeader / CacheSlot
+HEADER = struct.Struct("<8sIIIIQQQ16x")
+SHARD_HEADER = struct.Struct("<IIIIQQQIIQq")
+SLOT = struct.Struct("<16sqQIIHBBI")
+assert HEADER.size == 64 and SHARD_HEADER.size == 64 and SLOT.size == 48
+
+# Offsets of the header fields updated in place
+HEADER_DATA_END = 32
+HEADER_FILE_BYTES = 40
+
+
+def default_cache_path() -> str:
+    """Same file as the C++ clients: OLLAMA_CACHE_FILE or ~/.ollama_cache.bin"""
+    env = os.environ.get("OLLAMA_CACHE_FILE")
+    if env:
+        return env
+    home = os.environ.get("USERPROFILE" if os.name == "nt" else "HOME")
+    if home:
+        return os.path.join(home, ".ollama_cache.bin")
+    return "ollama_cache.bin"
+
+
+def default_cache_max_bytes() -> int:
+    """OLLAMA_CACHE_MAX_BYTES with K/M/G suffixes (0 = no byte budget)"""
+    env = os.environ.get("OLLAMA_CACHE_MAX_BYTES", "")
+    if not env:
+        return CACHE_DEFAULT_MAX_BYTES
+    digits = len(env) - len(env.lstrip("0123456789"))
+    n = int(env[:digits] or 0)
+    shift = {"k": 10, "m": 20, "g": 30}.get(env[digits:digits + 1].lower(), 0)
+    return n << shift
+
+
+def cache_normalize_enabled() -> bool:
+    """OLLAMA_CACHE_NORMALIZE=0 keys prompts byte by byte, like the C++ client"""
+    return os.environ.get("OLLAMA_CACHE_NORMALIZE") != "0"
+
+
+def normalize_prompt(prompt: str) -> bytes:
+    """Byte-exact port of normalizePrompt() in cpp/ollama_semantic.hpp"""
+    data = prompt.encode("utf-8")
+    out = bytearray()
+    pending_space = False
+    i = 0
+    while i < len(data):
+        c = data[i]
+        if c in (0x20, 0x09, 0x0A, 0x0D):
+            pending_space = len(out) > 0
+            i += 1
+            continue
+        # Leading ¿ and ¡
+        if not out and c == 0xC2 and i + 1 < len(data) and data[i + 1] in (0xBF, 0xA1):
+            i += 2
+            continue
+        if pending_space:
+            out.append(0x20)
+            pending_space = False
+        if 0x41 <= c <= 0x5A:
+            out.append(c + 32)
+        elif c == 0xC3 and i + 1 < len(data):
+            nxt = data[i + 1]
+            out.append(c)
+            out.append(nxt + 0x20 if 0x80 <= nxt <= 0x9E and nxt != 0x97 else nxt)
+            i += 1
+        else:
+            out.append(c)
+        i += 1
+    return bytes(out).rstrip(b".,;:!? ")
+
+
+def request_fingerprint(model: str, prompt: str, options: Optional[Dict[str, Any]] = None,
+                        system: str = "") -> bytes:
+    """128-bit key of a /api/generate request, identical to requestFingerprint() in C++.
+    Each field is hashed as a uint32 LE length followed by its bytes; options use the
+    canonical JSON form (sorted keys, no spaces) that nlohmann::json::dump() produces."""
+    key_prompt = normalize_prompt(prompt) if cache_normalize_enabled() else prompt.encode("utf-8")
+    canonical = json.dumps(options or {}, sort_keys=True, separators=(",", ":"), ensure_ascii=False)
+    h = hashlib.sha256()
+    for field in (model.encode("utf-8"), system.encode("utf-8"), key_prompt, canonical.encode("utf-8")):
+        h.update(struct.pack("<I", len(field)))
+        h.update(field)
+    return h.digest()[:16]
+
+
+def build_prompt(question: str, context: str = "") -> str:
+    """Prompt the Python tools send for a question over project files"""
+    return f"""Project files:
+{context}
+
+Question: {question}
+
+Answer:"""
+
+
+def compress_value(value: bytes):
+    if len(value) < CODEC_MIN_SIZE:
+        return CODEC_NONE, value
+    packed = zlib.compress(value, 1)
+    if len(packed) >= len(value):
+        return CODEC_NONE, value
+    return CODEC_ZLIB, packed
+
+
+def decompress_value(codec: int, data: bytes, raw_length: int) -> Optional[bytes]:
+    """None if the codec is not available here: treated as a cache miss"""
+    try:
+        if codec == CODEC_NONE:
+            return data
+        if codec == CODEC_ZLIB:
+            out = zlib.decompress(data)
+        elif codec == CODEC_LZ4 and lz4_block is not None:
+            out = lz4_block.decompress(data, uncompressed_size=raw_length)
+        elif codec == CODEC_ZSTD and zstandard is not None:
+            out = zstandard.ZstdDecompressor().decompress(data, max_output_size=raw_length)
+        else:
+            return None
+    except Exception:
+        return None
+    return out if len(out) == raw_length else None
+
+
 class OllamaCache:
-    def __init__(self, cache_dir: str = "cache", max_age_hours: int = 24):
-        self.cache_dir = cache_dir
+    def __init__(self, path: Optional[str] = None, max_age_hours: int = 24,
+                 max_entries: int = CACHE_DEFAULT_ENTRIES, max_bytes: Optional[int] = None):
+        self.path = path or default_cache_path()
         self.max_age_seconds = max_age_hours * 3600
-        self._ensure_cache_dir()
-    
-    def _ensure_cache_dir(self):
-        """Ensure cache directory exists"""
-        if not os.path.exists(self.cache_dir):
-            os.makedirs(self.cache_dir)
-    
-    def _generate_cache_key(self, question: str, context: str = "", model: str = "") -> str:
-        """Generate unique cache key from question, context and model"""
-        content = f"{question}|{context}|{model}"
-        return hashlib.md5(content.encode('utf-8')).hexdigest()
-    
-    def _get_cache_file_path(self, cache_key: str) -> str:
-        """Get full path for cache file"""
-        return os.path.join(self.cache_dir, f"{cache_key}.json")
-    
-    def get(self, question: str, context: str = "", model: str = "") -> Optional[str]:
-        """Get cached response if available and not expired"""
-        cache_key = self._generate_cache_key(question, context, model)
-        cache_file = self._get_cache_file_path(cache_key)
-        
-        if not os.path.exists(cache_file):
-            return None
-        
+        self.max_bytes = default_cache_max_bytes() if max_bytes is None else max_bytes
+        self.max_bytes_per_shard = self.max_bytes // CACHE_SHARDS
+        self.max_per_shard = max(1, (max_entries + CACHE_SHARDS - 1) // CACHE_SHARDS)
+        self.slots_per_shard = self.max_per_shard * 2
+        # fcntl locks belong to the process: threads are serialized before taking them
+        self._thread_lock = threading.RLock()
+        self._map = None
+        flags = os.O_RDWR | os.O_CREAT | getattr(os, "O_BINARY", 0)
+        self._fd = os.open(self.path, flags, 0o644)
+        if os.fstat(self._fd).st_size < self._data_start() + CACHE_DATA_INITIAL:
+            os.ftruncate(self._fd, self._data_start() + CACHE_DATA_INITIAL)
+        # Validate or initialize exclusively: two processes starting together don't both do it
+        with self._thread_lock, self._exclusive():
+            pass
+
+    def close(self):
+        with self._thread_lock:
+            if self._map is not None:
+                self._map.close()
+                self._map = None
+            if self._fd >= 0:
+                os.close(self._fd)
+                self._fd = -1
+
+    # --- file layout -------------------------------------------------------
+
+    def _data_start(self) -> int:
+        return HEADER.size + CACHE_SHARDS * SHARD_HEADER.size + CACHE_SHARDS * self.slots_per_shard * SLOT.size
+
+    def _shard_offset(self, sh: int) -> int:
+        return HEADER.size + sh * SHARD_HEADER.size
+
+    def _slot_offset(self, sh: int, idx: int) -> int:
+        base = HEADER.size + CACHE_SHARDS * SHARD_HEADER.size
+        return base + (sh * self.slots_per_shard + idx) * SLOT.size
+
+    def _header_u64(self, offset: int) -> int:
+        return struct.unpack_from("<Q", self._map, offset)[0]
+
+    def _set_header_u64(self, offset: int, value: int):
+        struct.pack_into("<Q", self._map, offset, value)
+
+    def _read_shard(self, sh: int) -> list:
+        return list(SHARD_HEADER.unpack_from(self._map, self._shard_offset(sh)))
+
+    def _write_shard(self, sh: int, fields: list):
+        SHARD_HEADER.pack_into(self._map, self._shard_offset(sh), *fields)
+
+    def _read_slot(self, sh: int, idx: int) -> list:
+        return list(SLOT.unpack_from(self._map, self._slot_offset(sh, idx)))
+
+    def _write_slot(self, sh: int, idx: int, fields: list):
+        SLOT.pack_into(self._map, self._slot_offset(sh, idx), *fields)
+
+    def _probe(self, h: int, i: int) -> int:
+        return ((h // CACHE_SHARDS) % self.slots_per_shard + i) % self.slots_per_shard
+
+    # --- cross-process locks -----------------------------------------------
+
+    def _lock(self, offset: int, exclusive: bool):
+        if fcntl is not None:
+            fcntl.lockf(self._fd, fcntl.LOCK_EX if exclusive else fcntl.LOCK_SH, 1, offset, os.SEEK_SET)
+            return
+        # msvcrt only has exclusive locks: stricter than needed, still correct
+        os.lseek(self._fd, offset, os.SEEK_SET)
+        while True:
+            try:
+                msvcrt.locking(self._fd, msvcrt.LK_LOCK, 1)
+                return
+            except OSError:
+                continue
+
+    def _unlock(self, offset: int):
+        if fcntl is not None:
+            fcntl.lockf(self._fd, fcntl.LOCK_UN, 1, offset, os.SEEK_SET)
+            return
+        os.lseek(self._fd, offset, os.SEEK_SET)
+        msvcrt.locking(self._fd, msvcrt.LK_UNLCK, 1)
+
+    @contextmanager
+    def _exclusive(self):
+        self._lock(CACHE_LOCK_MAP, True)
+        try:
+            self._attach()
+            yield
+        finally:
+            self._unlock(CACHE_LOCK_MAP)
+
+    @contextmanager
+    def _shared(self):
+        while True:
+            self._lock(CACHE_LOCK_MAP, False)
+            if self._map is not None and self._header_u64(HEADER_FILE_BYTES) == len(self._map):
+                break
+            # Another process resized the file: remap exclusively and retry
+            self._unlock(CACHE_LOCK_MAP)
+            with self._exclusive():
+                pass
         try:
-            with open(cache_file, 'r', encoding='utf-8') as f:
-                cache_data = json.load(f)
-            
-            # Check if cache is expired
-            cache_time = datetime.fromisoformat(cache_data['timestamp'])
-            if datetime.now() - cache_time > timedelta(seconds=self.max_age_seconds):
-                os.remove(cache_file)  # Remove expired cache
+            yield
+        finally:
+            self._unlock(CACHE_LOCK_MAP)
+
+    @contextmanager
+    def _shard(self, sh: int):
+        self._lock(CACHE_LOCK_SHARD + sh, True)
+        try:
+            yield
+        finally:
+            self._unlock(CACHE_LOCK_SHARD + sh)
+
+    # --- attach / initialize (map held exclusively) ------------------------
+
+    def _remap(self):
+        if self._map is not None:
+            self._map.close()
+            self._map = None
+        size = os.fstat(self._fd).st_size
+        if size > 0:
+            self._map = mmap.mmap(self._fd, size, access=mmap.ACCESS_WRITE)
+
+    def _header_valid(self) -> bool:
+        if self._map is None or len(self._map) < self._data_start():
+            return False
+        magic, version, shards, slots, _, data_offset, data_end, _ = HEADER.unpack_from(self._map, 0)
+        return (magic == CACHE_FILE_MAGIC and version == CACHE_FILE_VERSION and shards == CACHE_SHARDS and
+                slots == self.slots_per_shard and data_offset == self._data_start() and
+                data_offset <= data_end <= len(self._map))
+
+    def _adopt_geometry(self):
+        """A valid file overrides this process's configuration"""
+        if self._map is None or len(self._map) < HEADER.size:
+            return
+        magic, version, shards, slots = HEADER.unpack_from(self._map, 0)[:4]
+        if magic == CACHE_FILE_MAGIC and version == CACHE_FILE_VERSION and shards == CACHE_SHARDS and slots >= 2:
+            self.slots_per_shard = slots
+            self.max_per_shard = slots // 2
+
+    def _initialize(self):
+        start = self._data_start()
+        self._map[0:start] = bytes(start)
+        HEADER.pack_into(self._map, 0, CACHE_FILE_MAGIC, CACHE_FILE_VERSION, CACHE_SHARDS,
+                         self.slots_per_shard, 0, start, start, len(self._map))
+
+    def _attach(self):
+        if (self._map is not None and len(self._map) == os.fstat(self._fd).st_size and
+                self._header_u64(HEADER_FILE_BYTES) == len(self._map) and self._header_valid()):
+            return
+        self._remap()
+        self._adopt_geometry()
+        if not self._header_valid():
+            min_size = self._data_start() + CACHE_DATA_INITIAL
+            if self._map is None or len(self._map) < min_size:
+                os.ftruncate(self._fd, min_size)
+                self._remap()
+            self._initialize()
+        self._set_header_u64(HEADER_FILE_BYTES, len(self._map))
+
+    # --- shard operations (shard lock held) --------------------------------
+
+    def _find(self, sh: int, key: bytes, h: int) -> int:
+        for i in range(self.slots_per_shard):
+            idx = self._probe(h, i)
+            slot = self._read_slot(sh, idx)
+            if slot[5] == SLOT_EMPTY:
+                return -1
+            if slot[5] == SLOT_USED and slot[0] == key:
+                return idx
+        return -1
+
+    def _erase(self, sh: int, idx: int):
+        slot = self._read_slot(sh, idx)
+        st = self._read_shard(sh)
+        st[4] += slot[3]                 # deadBytes
+        st[5] -= slot[3]                 # liveBytes
+        st[6] -= slot[8]                 # rawBytes
+        st[9] -= slot[4]                 # accessTotal
+        if slot[7] != CODEC_NONE:
+            st[7] -= 1                   # compressedCount
+        st[0] -= 1                       # entryCount
+        st[1] += 1                       # tombstoneCount
+        slot[5] = SLOT_DELETED
+        self._write_slot(sh, idx, slot)
+        self._write_shard(sh, st)
+
+    def _sweep(self, sh: int, now: int, budget: int) -> int:
+        erased = 0
+        for _ in range(min(budget, self.slots_per_shard)):
+            st = self._read_shard(sh)
+            idx = st[3] % self.slots_per_shard
+            st[3] = (idx + 1) % self.slots_per_shard
+            self._write_shard(sh, st)
+            slot = self._read_slot(sh, idx)
+            if slot[5] == SLOT_USED and now >= slot[1]:
+                self._erase(sh, idx)
+                erased += 1
+        return erased
+
+    def _evict_one(self, sh: int, now: int) -> bool:
+        """CLOCK: expired entries first, then the first one not referenced since the last pass"""
+        for _ in range(2 * self.slots_per_shard):
+            st = self._read_shard(sh)
+            idx = st[2] % self.slots_per_shard
+            st[2] = (idx + 1) % self.slots_per_shard
+            self._write_shard(sh, st)
+            slot = self._read_slot(sh, idx)
+            if slot[5] != SLOT_USED:
+                continue
+            if now < slot[1] and slot[6]:
+                slot[6] = 0
+                self._write_slot(sh, idx, slot)
+                continue
+            self._erase(sh, idx)
+            return True
+        return False
+
+    def _over_budget(self, sh: int, length: int) -> bool:
+        st = self._read_shard(sh)
+        if st[0] == 0:
+            return False
+        return st[0] >= self.max_per_shard or (
+            self.max_bytes_per_shard > 0 and st[5] + length > self.max_bytes_per_shard)
+
+    def _rehash(self, sh: int):
+        live = [s for s in (self._read_slot(sh, i) for i in range(self.slots_per_shard)) if s[5] == SLOT_USED]
+        start = self._slot_offset(sh, 0)
+        self._map[start:start + self.slots_per_shard * SLOT.size] = bytes(self.slots_per_shard * SLOT.size)
+        st = self._read_shard(sh)
+        st[10] = min((s[1] for s in live), default=0)
+        for slot in live:
+            h = int.from_bytes(slot[0][:8], "little")
+            for i in range(self.slots_per_shard):
+                idx = self._probe(h, i)
+                if self._read_slot(sh, idx)[5] == SLOT_EMPTY:
+                    self._write_slot(sh, idx, slot)
+                    break
+        st[1] = 0
+        self._write_shard(sh, st)
+
+    def _insert(self, sh: int, key: bytes, h: int, stored: bytes, codec: int, raw_length: int,
+                offset: int, ttl_seconds: int):
+        now = int(time.time())
+        existing = self._find(sh, key, h)
+        if existing >= 0:
+            self._erase(sh, existing)
+        self._sweep(sh, now, CACHE_SWEEP_PER_INSERT)
+        while self._over_budget(sh, len(stored)) and self._evict_one(sh, now):
+            pass
+        if self._read_shard(sh)[1] > self.slots_per_shard // 4:
+            self._rehash(sh)
+
+        for i in range(self.slots_per_shard):
+            idx = self._probe(h, i)
+            slot = self._read_slot(sh, idx)
+            if slot[5] == SLOT_USED:
+                continue
+            st = self._read_shard(sh)
+            if slot[5] == SLOT_DELETED:
+                st[1] -= 1
+            expiry = now + ttl_seconds
+            self._map[offset:offset + len(stored)] = stored
+            self._write_slot(sh, idx, [key, expiry, offset, len(stored), 1, SLOT_USED, 0, codec, raw_length])
+            if st[0] == 0 or expiry < st[10]:
+                st[10] = expiry
+            st[0] += 1
+            st[5] += len(stored)
+            st[6] += raw_length
+            st[9] += 1
+            if codec != CODEC_NONE:
+                st[7] += 1
+            self._write_shard(sh, st)
+            return
+
+    # --- data region -------------------------------------------------------
+
+    def _alloc(self, length: int) -> int:
+        """Reserve at the end of the data region; -1 if the file must grow"""
+        self._lock(CACHE_LOCK_DATA, True)
+        try:
+            end = self._header_u64(HEADER_DATA_END)
+            if end + length > len(self._map):
+                return -1
+            self._set_header_u64(HEADER_DATA_END, end + length)
+            return end
+        finally:
+            self._unlock(CACHE_LOCK_DATA)
+
+    def _compact(self):
+        """Move live data to the start of the data region (map held exclusively)"""
+        order = []
+        for sh in range(CACHE_SHARDS):
+            for idx in range(self.slots_per_shard):
+                slot = self._read_slot(sh, idx)
+                if slot[5] == SLOT_USED:
+                    order.append((slot[2], sh, idx))
+            st = self._read_shard(sh)
+            st[4] = 0
+            self._write_shard(sh, st)
+        w = self._data_start()
+        for _, sh, idx in sorted(order):
+            slot = self._read_slot(sh, idx)
+            if slot[2] != w:
+                self._map.move(w, slot[2], slot[3])
+                slot[2] = w
+                self._write_slot(sh, idx, slot)
+            w += slot[3]
+        self._set_header_u64(HEADER_DATA_END, w)
+
+    def _grow(self, length: int):
+        """Compact or grow until 'length' bytes fit (map held exclusively)"""
+        end = self._header_u64(HEADER_DATA_END)
+        if end + length <= len(self._map):
+            return
+        used = end - self._data_start()
+        dead = sum(self._read_shard(sh)[4] for sh in range(CACHE_SHARDS))
+        if dead * 2 >= used:
+            self._compact()
+            end = self._header_u64(HEADER_DATA_END)
+            if end + length <= len(self._map):
+                return
+        new_size = len(self._map)
+        while end + length > new_size:
+            new_size *= 2
+        self._map.close()
+        self._map = None
+        os.ftruncate(self._fd, new_size)
+        self._remap()
+        self._set_header_u64(HEADER_FILE_BYTES, len(self._map))
+
+    # --- fingerprint-level API (same keys as the C++ clients) --------------
+
+    def get_request(self, model: str, prompt: str, options: Optional[Dict[str, Any]] = None,
+                    system: str = "") -> Optional[str]:
+        return self.get_key(request_fingerprint(model, prompt, options, system))
+
+    def set_request(self, model: str, prompt: str, response: str, options: Optional[Dict[str, Any]] = None,
+                    system: str = ""):
+        self.set_key(request_fingerprint(model, prompt, options, system), response)
+
+    def get_key(self, key: bytes) -> Optional[str]:
+        """Valid value or None; an expired entry is erased when found"""
+        h = int.from_bytes(key[:8], "little")
+        sh = h % CACHE_SHARDS
+        with self._thread_lock, self._shared(), self._shard(sh):
+            idx = self._find(sh, key, h)
+            if idx < 0:
                 return None
-            
-            return cache_data['response']
-            
-        except (json.JSONDecodeError, KeyError, OSError):
-            # Remove corrupted cache file
-            if os.path.exists(cache_file):
-                os.remove(cache_file)
-            return None
-    
-    def set(self, question: str, response: str, context: str = "", model: str = ""):
-        """Cache response with metadata"""
-        cache_key = self._generate_cache_key(question, context, model)
-        cache_file = self._get_cache_file_path(cache_key)
-        
-        cache_data = {
-            'question': question,
-            'response': response,
-            'context': context,
-            'model': model,
-            'timestamp': datetime.now().isoformat(),
-            'cache_key': cache_key
-        }
-        
+            slot = self._read_slot(sh, idx)
+            if int(time.time()) >= slot[1]:
+                self._erase(sh, idx)
+                return None
+            slot[4] += 1
+            slot[6] = 1
+            self._write_slot(sh, idx, slot)
+            st = self._read_shard(sh)
+            st[9] += 1
+            self._write_shard(sh, st)
+            codec, raw_length = slot[7], slot[8]
+            data = self._map[slot[2]:slot[2] + slot[3]]
+        value = decompress_value(codec, data, raw_length)
+        return value.decode("utf-8", errors="replace") if value is not None else None
+
+    def set_key(self, key: bytes, response: str, ttl_seconds: Optional[int] = None):
+        value = response.encode("utf-8")
+        codec, stored = compress_value(value)
+        if self.max_bytes_per_shard > 0 and len(stored) > self.max_bytes_per_shard:
+            return
+        h = int.from_bytes(key[:8], "little")
+        sh = h % CACHE_SHARDS
+        ttl = self.max_age_seconds if ttl_seconds is None else ttl_seconds
         try:
-            with open(cache_file, 'w', encoding='utf-8') as f:
-                json.dump(cache_data, f, ensure_ascii=False, indent=2)
+            with self._thread_lock:
+                while True:
+                    with self._shared():
+                        offset = self._alloc(len(stored))
+                        if offset >= 0:
+                            with self._shard(sh):
+                                self._insert(sh, key, h, stored, codec, len(value), offset, ttl)
+                            return
+                    with self._exclusive():
+                        self._grow(len(stored))
         except OSError as e:
             print(f"⚠️ Warning: Could not cache response: {e}")
-    
-    def clear(self, max_age_hours: Optional[int] = None):
-        """Clear expired cache entries"""
-        if max_age_hours is None:
-            max_age_hours = self.max_age_seconds // 3600
-        
-        max_age_seconds = max_age_hours * 3600
-        cleared_count = 0
-        
-        for filename in os.listdir(self.cache_dir):
-            if not filename.endswith('.json'):
-                continue
-            
-            file_path = os.path.join(self.cache_dir, filename)
-            try:
-                file_time = os.path.getmtime(file_path)
-                if time.time() - file_time > max_age_seconds:
-                    os.remove(file_path)
-                    cleared_count += 1
-            except OSError:
-                continue
-        
-        return cleared_count
-    
+
+    # --- question/context API used by the Python tools ---------------------
+
+    def get(self, question: str, context: str = "", model: str = "") -> Optional[str]:
+        """Get cached response if available and not expired"""
+        return self.get_request(model, build_prompt(question, context))
+
+    def set(self, question: str, response: str, context: str = "", model: str = ""):
+        """Cache response under the same key the request would have in C++"""
+        self.set_request(model, build_prompt(question, context), response)
+
+    def cleanup(self) -> int:
+        """Erase every expired entry (explicit maintenance; lookups already drop expired ones)"""
+        now = int(time.time())
+        erased = 0
+        with self._thread_lock, self._shared():
+            for sh in range(CACHE_SHARDS):
+                with self._shard(sh):
+                    erased += self._sweep(sh, now, self.slots_per_shard)
+                    if self._read_shard(sh)[1] > self.slots_per_shard // 4:
+                        self._rehash(sh)
+        return erased
+
+    def clear(self):
+        """Drop every entry, for every tool sharing the file"""
+        with self._thread_lock, self._exclusive():
+            self._map.close()
+            self._map = None
+            os.ftruncate(self._fd, self._data_start() + CACHE_DATA_INITIAL)
+            self._remap()
+            self._initialize()
+
     def get_stats(self) -> Dict[str, Any]:
-        """Get cache statistics"""
-        total_files = 0
-        total_size = 0
-        oldest_file = None
-        newest_file = None
-        
-        for filename in os.listdir(self.cache_dir):
-            if not filename.endswith('.json'):
-                continue
-            
-            file_path = os.path.join(self.cache_dir, filename)
-            try:
-                file_stat = os.stat(file_path)
-                total_files += 1
-                total_size += file_stat.st_size
-                
-                file_time = datetime.fromtimestamp(file_stat.st_mtime)
-                if oldest_file is None or file_time < oldest_file:
-                    oldest_file = file_time
-                if newest_file is None or file_time > newest_file:
-                    newest_file = file_time
-            except OSError:
-                continue
-        
-        return {
-            'total_files': total_files,
-            'total_size_mb': round(total_size / (1024 * 1024), 2),
-            'oldest_file': oldest_file.isoformat() if oldest_file else None,
-            'newest_file': newest_file.isoformat() if newest_file else None,
-            'cache_dir': self.cache_dir,
-            'max_age_hours': self.max_age_seconds // 3600
-        }
+        """Cache statistics from the shard header counters: O(1) per shard. Only a shard
+        that may hold expired entries (now >= minExpiry) is scanned to split valid/expired."""
+        stats = {'total': 0, 'valid': 0, 'expired': 0, 'compressed': 0, 'total_access': 0,
+                 'bytes': 0, 'raw_bytes': 0}
+        now = int(time.time())
+        with self._thread_lock, self._shared():
+            stats['file_bytes'] = len(self._map)
+            for sh in range(CACHE_SHARDS):
+                with self._shard(sh):
+                    st = self._read_shard(sh)
+                    stats['total'] += st[0]
+                    stats['compressed'] += st[7]
+                    stats['total_access'] += st[9]
+                    stats['bytes'] += st[5]
+                    stats['raw_bytes'] += st[6]
+                    if st[0] == 0 or now < st[10]:
+                        stats['valid'] += st[0]
+                        continue
+                    st[10] = 0
+                    for idx in range(self.slots_per_shard):
+                        slot = self._read_slot(sh, idx)
+                        if slot[5] != SLOT_USED:
+                            continue
+                        if st[10] == 0 or slot[1] < st[10]:
+                            st[10] = slot[1]
+                        stats['valid' if now < slot[1] else 'expired'] += 1
+                    self._write_shard(sh, st)
+        stats['byte_budget'] = self.max_bytes
+        stats['cache_file'] = self.path
+        stats['max_age_hours'] = self.max_age_seconds // 3600
+        return stats
 
 # Global cache instance
 _cache = OllamaCache()
@@ -144,10 +650,10 @@ def cache_response(question: str, response: str, context: str = "", model: str =
     """Cache response for future use"""
     _cache.set(question, response, context, model)
 
-def clear_cache(max_age_hours: Optional[int] = None) -> int:
+def clear_cache() -> int:
     """Clear expired cache entries"""
-    return _cache.clear(max_age_hours)
+    return _cache.cleanup()
 
 def get_cache_stats() -> Dict[str, Any]:
     """Get cache statistics"""
-    return _cache.get_stats()
\ No newline at end of file
+    return _cache.get_stats()
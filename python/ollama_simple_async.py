@@ -20,7 +20,7 @@ from concurrent.futures import ThreadPoolExecutor
 SYNC_MODE = False
 
 # Import our new modules
-from ollama_cache import get_cached_response, cache_response, get_cache_stats
+from ollama_cache import build_prompt, get_cached_response, cache_response, get_cache_stats
 from ollama_errors import (
     handle_error, validate_question, validate_model, validate_file_path,
     retry_operation, check_ollama_health, get_system_info, get_error_stats
@@ -125,12 +125,7 @@ async def query_ollama(question, context="", model="codellama:7b-instruct"):
     
     async def _query():
         try:
-            prompt = f"""Project files:
-{context}
-
-Question: {question}
-
-Answer:"""
+            prompt = build_prompt(question, context)
 
             async with aiohttp.ClientSession() as session:
                 async with session.post(
@@ -166,12 +161,7 @@ async def query_ollama_sync(question, context, model):
     try:
         import requests
         
-        prompt = f"""Project files:
-{context}
-
-Question: {question}
-
-Answer:"""
+        prompt = build_prompt(question, context)
 
         data = {
             "model": model,
@@ -258,7 +248,7 @@ async def main():
     
     # Check cache first
     print("Checking cache...")
-    cached_response = get_cached_response(question, context)
+    cached_response = get_cached_response(question, context, model)
     
     if cached_response:
         print("OK: Response found in cache!")
@@ -281,7 +271,7 @@ async def main():
             response = await query_ollama(question, context, model)
         
         # Cache the response
-        cache_response(question, context, response)
+        cache_response(question, response, context, model)
         
         print("")
         print("=" * 50)